@@ -0,0 +1,151 @@
+#pragma once
+// microbench: minimal header-only benchmark harness (vendored, no deps)
+//
+// - Each case is calibrated until one batch of iterations takes at least
+//   min_time, then run for `reps` timed batches after one warmup batch.
+// - Per-op time is reported as min / median / mean / stddev / MAD over the
+//   batches, plus the coefficient of variation; median and MAD are the
+//   numbers to compare, they ignore preempted batches.
+// - Results print as a table and, with a path, as JSON (see write_json).
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace microbench {
+
+// Keep a value (and what it points to) alive without emitting code for it
+template <class T>
+inline void do_not_optimize(const T& v){ asm volatile("" : : "r,m"(v) : "memory"); }
+inline void clobber_memory(){ asm volatile("" : : : "memory"); }
+
+struct Stats {
+  double min, median, mean, stddev, mad, cv;
+};
+
+struct Result {
+  std::string name;
+  std::map<std::string, long long> params;
+  uint64_t iters;           // per batch
+  std::vector<double> ns_per_op;  // one per batch
+  Stats st;
+};
+
+// fn(iters) runs the measured operation iters times
+using Body = std::function<void(uint64_t iters)>;
+
+struct Case {
+  std::string name;
+  std::map<std::string, long long> params;
+  Body body;
+};
+
+struct Options {
+  int reps = 15;
+  double min_time_ms = 20.0;
+  std::string filter;       // substring of the full name
+};
+
+inline std::string full_name(const Case& c){
+  std::string n = c.name;
+  for (auto& [k, v] : c.params) n += "/" + k + "=" + std::to_string(v);
+  return n;
+}
+
+inline Stats compute(std::vector<double> v){
+  Stats s{};
+  std::sort(v.begin(), v.end());
+  size_t n = v.size();
+  auto med = [](const std::vector<double>& x){
+    size_t m = x.size() / 2;
+    return x.size() % 2 ? x[m] : 0.5 * (x[m-1] + x[m]);
+  };
+  s.min = v.front();
+  s.median = med(v);
+  double sum = 0;
+  for (double x : v) sum += x;
+  s.mean = sum / n;
+  double var = 0;
+  for (double x : v) var += (x - s.mean) * (x - s.mean);
+  s.stddev = n > 1 ? std::sqrt(var / (n - 1)) : 0.0;
+  std::vector<double> dev;
+  for (double x : v) dev.push_back(std::fabs(x - s.median));
+  std::sort(dev.begin(), dev.end());
+  s.mad = med(dev);
+  s.cv = s.mean > 0 ? s.stddev / s.mean : 0.0;
+  return s;
+}
+
+inline double time_batch(const Body& body, uint64_t iters){
+  auto t0 = std::chrono::steady_clock::now();
+  body(iters);
+  auto t1 = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(t1 - t0).count();
+}
+
+inline Result run(const Case& c, const Options& o){
+  Result r{full_name(c), c.params, 1, {}, {}};
+  const double target = o.min_time_ms * 1e6;
+  for (;;){  // calibrate: grow until one batch reaches min_time
+    double t = time_batch(c.body, r.iters);
+    if (t >= target || r.iters >= (1ull << 40)) break;
+    double grow = t > 0 ? std::min(10.0, std::max(1.5, 1.2 * target / t)) : 10.0;
+    r.iters = static_cast<uint64_t>(r.iters * grow) + 1;
+  }
+  time_batch(c.body, r.iters);  // warmup at the final size
+  for (int i = 0; i < o.reps; i++)
+    r.ns_per_op.push_back(time_batch(c.body, r.iters) / r.iters);
+  r.st = compute(r.ns_per_op);
+  return r;
+}
+
+inline void print_header(FILE* f){
+  std::fprintf(f, "%-44s %12s %10s %10s %8s %6s\n", "benchmark", "iters", "median_ns", "min_ns", "mad_ns", "cv%");
+}
+
+inline void print_row(FILE* f, const Result& r){
+  std::fprintf(f, "%-44s %12llu %10.2f %10.2f %8.2f %6.1f\n", r.name.c_str(),
+               static_cast<unsigned long long>(r.iters), r.st.median, r.st.min, r.st.mad, 100.0 * r.st.cv);
+}
+
+// {"context":{...},"benchmarks":[{"name","params","iterations","repetitions",
+//   "ns_per_op":{"min","median","mean","stddev","mad","cv","samples":[...]}}]}
+inline bool write_json(const std::string& path, const std::map<std::string, std::string>& context,
+                       const std::vector<Result>& results){
+  FILE* f = path == "-" ? stdout : std::fopen(path.c_str(), "w");
+  if (!f) return false;
+  std::fprintf(f, "{\n  \"context\": {");
+  bool first = true;
+  for (auto& [k, v] : context){
+    std::fprintf(f, "%s\"%s\": \"%s\"", first ? "" : ", ", k.c_str(), v.c_str());
+    first = false;
+  }
+  std::fprintf(f, "},\n  \"benchmarks\": [\n");
+  for (size_t i = 0; i < results.size(); i++){
+    const Result& r = results[i];
+    std::fprintf(f, "    {\"name\": \"%s\", \"params\": {", r.name.c_str());
+    first = true;
+    for (auto& [k, v] : r.params){
+      std::fprintf(f, "%s\"%s\": %lld", first ? "" : ", ", k.c_str(), v);
+      first = false;
+    }
+    std::fprintf(f, "}, \"iterations\": %llu, \"repetitions\": %zu,\n     \"ns_per_op\": "
+                    "{\"min\": %.3f, \"median\": %.3f, \"mean\": %.3f, \"stddev\": %.3f, \"mad\": %.3f, \"cv\": %.4f, \"samples\": [",
+                 static_cast<unsigned long long>(r.iters), r.ns_per_op.size(),
+                 r.st.min, r.st.median, r.st.mean, r.st.stddev, r.st.mad, r.st.cv);
+    for (size_t j = 0; j < r.ns_per_op.size(); j++)
+      std::fprintf(f, "%s%.3f", j ? ", " : "", r.ns_per_op[j]);
+    std::fprintf(f, "]}}%s\n", i + 1 < results.size() ? "," : "");
+  }
+  std::fprintf(f, "  ]\n}\n");
+  bool ok = !std::ferror(f);
+  if (f != stdout) ok = (std::fclose(f) == 0) && ok;
+  return ok;
+}
+
+}  // namespace microbench
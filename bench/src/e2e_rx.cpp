@@ -0,0 +1,131 @@
+#include "latency.hpp"
+#include "ranger_can.hpp"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <csignal>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+/*
+ * ranger-e2e-rx: ISO-TP receiver end of the end-to-end latency benchmark
+ * - Receives RangerMsgTs frames (ranger-can --with-ts), stamps recv() on
+ *   CLOCK_MONOTONIC and histograms each stage of the frame's oldest fresh
+ *   measurement, from its falling edge to here.
+ * - Stops after --duration, or --idle seconds without frames once they
+ *   started; prints a table and optionally writes JSON (scripts/bench_e2e.sh).
+ */
+
+static volatile std::sig_atomic_t g_stop = 0;
+static void on_sigint(int){ g_stop = 1; }
+
+// edge -> ranger-u read -> median -> frame out -> ranger-can in -> send -> recv
+static const char* const kStages[] = {
+  "edge_urecv", "urecv_filt", "filt_out", "out_canin", "canin_tx", "tx_rx", "edge_rx",
+};
+static constexpr int kNStages = sizeof(kStages) / sizeof(kStages[0]);
+
+struct Args {
+  std::string ifname = "vcan0";
+  uint32_t tx_id = 0x700;  // ranger-can's rx
+  uint32_t rx_id = 0x701;  // ranger-can's tx
+  double duration_s = 0.0;
+  double idle_s = 2.0;
+  std::string json;
+  std::string label;
+};
+
+static void usage(const char* prog){
+  std::cerr << "Usage: " << prog << " [--if vcan0] [--tx 0x700] [--rx 0x701] [--duration S] [--idle 2]\n"
+            << "       [--json out.json] [--label NAME]\n";
+}
+
+static Args parse_args(int argc, char** argv){
+  Args a;
+  for (int i=1;i<argc;i++){
+    std::string k = argv[i];
+    auto need = [&](const char* name){ if (i+1>=argc) { std::cerr<<"Missing value for "<<name<<"\n"; usage(argv[0]); std::exit(2);} return std::string(argv[++i]); };
+    if (k=="--if") a.ifname = need("--if");
+    else if (k=="--tx") a.tx_id = std::stoul(need("--tx"), nullptr, 0);
+    else if (k=="--rx") a.rx_id = std::stoul(need("--rx"), nullptr, 0);
+    else if (k=="--duration") a.duration_s = std::stod(need("--duration"));
+    else if (k=="--idle") a.idle_s = std::stod(need("--idle"));
+    else if (k=="--json") a.json = need("--json");
+    else if (k=="--label") a.label = need("--label");
+    else if (k=="-h" || k=="--help"){ usage(argv[0]); std::exit(0); }
+    else { usage(argv[0]); std::exit(2); }
+  }
+  return a;
+}
+
+int main(int argc, char** argv){
+  std::signal(SIGINT, on_sigint);
+  std::signal(SIGTERM, on_sigint);
+  auto args = parse_args(argc, argv);
+
+  int s = open_isotp(args.ifname, args.tx_id, args.rx_id);
+  if (s < 0) return 1;
+
+  LatencyHist h[kNStages];
+  uint64_t frames = 0, stamped = 0, short_frames = 0;
+  const int64_t t_start = mono_ns();
+  int64_t t_last = 0;
+
+  while (!g_stop){
+    int64_t now = mono_ns();
+    if (args.duration_s > 0 && now - t_start >= static_cast<int64_t>(args.duration_s * 1e9)) break;
+    if (t_last && now - t_last >= static_cast<int64_t>(args.idle_s * 1e9)) break;
+
+    pollfd p{ s, POLLIN, 0 };
+    if (poll(&p, 1, 100) <= 0) continue;
+
+    RangerMsgTs m{};
+    ssize_t n = recv(s, &m, sizeof(m), 0);
+    const int64_t rx = mono_ns();
+    if (n < 0){ perror("recv"); break; }
+    t_last = rx;
+    frames++;
+    if (n != static_cast<ssize_t>(sizeof(m))){ short_frames++; continue; }  // plain RangerMsg
+    if (!m.edge_ns) continue;  // no fresh measurement in that frame
+    stamped++;
+
+    const uint64_t t[] = { m.edge_ns, m.urecv_ns, m.filt_ns, m.out_ns, m.can_in_ns, m.can_tx_ns,
+                           static_cast<uint64_t>(rx) };
+    for (int i = 0; i < kNStages - 1; i++)
+      if (t[i+1] >= t[i]) h[i].record(t[i+1] - t[i]);
+    if (t[6] >= t[0]) h[kNStages-1].record(t[6] - t[0]);
+  }
+  close(s);
+
+  std::printf("# %s frames=%llu stamped=%llu without_ts=%llu\n", args.label.empty() ? "e2e" : args.label.c_str(),
+              static_cast<unsigned long long>(frames), static_cast<unsigned long long>(stamped),
+              static_cast<unsigned long long>(short_frames));
+  std::printf("# stage count p50_ns p99_ns p999_ns max_ns mean_ns\n");
+  for (int i = 0; i < kNStages; i++)
+    std::printf("%s %llu %llu %llu %llu %llu %llu\n", kStages[i], static_cast<unsigned long long>(h[i].count()),
+                static_cast<unsigned long long>(h[i].percentile(0.50)),
+                static_cast<unsigned long long>(h[i].percentile(0.99)),
+                static_cast<unsigned long long>(h[i].percentile(0.999)),
+                static_cast<unsigned long long>(h[i].max()), static_cast<unsigned long long>(h[i].mean()));
+
+  if (!args.json.empty()){
+    FILE* f = std::fopen(args.json.c_str(), "w");
+    if (!f){ perror("open json"); return 1; }
+    std::fprintf(f, "{\"label\": \"%s\", \"frames\": %llu, \"stamped\": %llu, \"stages\": [\n", args.label.c_str(),
+                 static_cast<unsigned long long>(frames), static_cast<unsigned long long>(stamped));
+    for (int i = 0; i < kNStages; i++)
+      std::fprintf(f, "  {\"name\": \"%s\", \"count\": %llu, \"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, "
+                      "\"max_ns\": %llu, \"mean_ns\": %.1f}%s\n",
+                   kStages[i], static_cast<unsigned long long>(h[i].count()),
+                   static_cast<unsigned long long>(h[i].percentile(0.50)),
+                   static_cast<unsigned long long>(h[i].percentile(0.99)),
+                   static_cast<unsigned long long>(h[i].percentile(0.999)),
+                   static_cast<unsigned long long>(h[i].max()), h[i].mean(), i + 1 < kNStages ? "," : "");
+    std::fprintf(f, "]}\n");
+    std::fclose(f);
+  }
+  return stamped ? 0 : 1;
+}
@@ -0,0 +1,224 @@
+#include "microbench.hpp"
+
+#include "filter_median.hpp"
+#include "pulse_measure.hpp"
+#include "telemetry.hpp"
+#include "sensor_table.hpp"
+#include "ranger_can.hpp"
+
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * ranger-bench: microbenchmarks of the per-measurement hot paths
+ * - MedianFilter::push across window sizes
+ * - PulseTracker::on_edge (one rise + one fall per op)
+ * - one pulse per op round-robin over N sensors: SensorTable vs per-sensor
+ *   heap objects (the pre-SensorTable ranger-u layout)
+ * - to_json / append_json (reused buffer) / to_csv_row across sensor counts
+ * - parse_jsonl_line and RangerMsg packing (ranger-can)
+ * Build with -DCMAKE_BUILD_TYPE=Release and ENABLE_ASAN=OFF for real numbers.
+ */
+
+using microbench::Case;
+using microbench::do_not_optimize;
+
+static const long long kSensors[] = {1, 5, 16, 64};
+
+// distances in meters, fixed seed so every run sees the same data
+static std::vector<double> sample_dists(size_t n){
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> d(0.02, 4.0);
+  std::vector<double> v(n);
+  for (auto& x : v) x = d(rng);
+  return v;
+}
+
+static TelemetryFrame sample_frame(size_t sensors){
+  TelemetryFrame tf;
+  auto d = sample_dists(sensors);
+  tf.dist_m.assign(d.begin(), d.end());
+  return tf;
+}
+
+static std::vector<Case> make_cases(){
+  std::vector<Case> cs;
+
+  for (long long w : {3, 5, 7, 9, 15}){
+    cs.push_back({"median_push", {{"window", w}}, [w](uint64_t iters){
+      static const auto vals = sample_dists(1024);
+      MedianFilter mf(static_cast<size_t>(w));
+      for (uint64_t i = 0; i < iters; i++){
+        auto m = mf.push(vals[i & 1023]);
+        do_not_optimize(m);
+      }
+    }});
+  }
+
+  cs.push_back({"pulse_on_edge", {}, [](uint64_t iters){
+    PulseTracker t(343.0);
+    std::chrono::nanoseconds ts{0};
+    for (uint64_t i = 0; i < iters; i++){
+      auto r = t.on_edge({Edge::Rising, ts});
+      do_not_optimize(r);
+      ts += std::chrono::nanoseconds(5831000);  // ~1 m
+      auto f = t.on_edge({Edge::Falling, ts});
+      do_not_optimize(f);
+      ts += std::chrono::nanoseconds(20000000);
+    }
+  }});
+
+  for (long long n : {1LL, 16LL, 64LL, 256LL}){
+    cs.push_back({"table_pulse", {{"sensors", n}}, [n](uint64_t iters){
+      SensorTable st(static_cast<size_t>(n));
+      std::chrono::nanoseconds ts{0};
+      size_t i = 0;
+      for (uint64_t k = 0; k < iters; k++){
+        st.on_edge(i, {Edge::Rising, ts});
+        auto p = st.on_edge(i, {Edge::Falling, ts + std::chrono::nanoseconds(5831000 + (k & 1023))});
+        auto m = st.push_filter(i, p->distance_m);
+        do_not_optimize(m);
+        ts += std::chrono::nanoseconds(20000);
+        if (++i == static_cast<size_t>(n)) i = 0;
+      }
+    }});
+    cs.push_back({"heap_ctx_pulse", {{"sensors", n}}, [n](uint64_t iters){
+      struct Ctx { PulseTracker t{343.0}; MedianFilter mf{5}; };
+      std::vector<std::unique_ptr<Ctx>> ctx;
+      for (long long j = 0; j < n; j++) ctx.push_back(std::make_unique<Ctx>());
+      std::chrono::nanoseconds ts{0};
+      size_t i = 0;
+      for (uint64_t k = 0; k < iters; k++){
+        Ctx& c = *ctx[i];
+        c.t.on_edge({Edge::Rising, ts});
+        auto p = c.t.on_edge({Edge::Falling, ts + std::chrono::nanoseconds(5831000 + (k & 1023))});
+        auto m = c.mf.push(p->distance_m);
+        do_not_optimize(m);
+        ts += std::chrono::nanoseconds(20000);
+        if (++i == static_cast<size_t>(n)) i = 0;
+      }
+    }});
+  }
+
+  for (long long n : kSensors){
+    cs.push_back({"to_json", {{"sensors", n}}, [n](uint64_t iters){
+      const TelemetryFrame tf = sample_frame(static_cast<size_t>(n));
+      for (uint64_t i = 0; i < iters; i++){
+        std::string s = to_json(tf);
+        do_not_optimize(s);
+      }
+    }});
+    cs.push_back({"append_json", {{"sensors", n}}, [n](uint64_t iters){
+      const TelemetryFrame tf = sample_frame(static_cast<size_t>(n));
+      std::string s;
+      for (uint64_t i = 0; i < iters; i++){
+        s.clear();
+        append_json(s, tf);
+        do_not_optimize(s);
+      }
+    }});
+    cs.push_back({"csv_row", {{"sensors", n}}, [n](uint64_t iters){
+      const TelemetryFrame tf = sample_frame(static_cast<size_t>(n));
+      for (uint64_t i = 0; i < iters; i++){
+        std::string s = to_csv_row(static_cast<long long>(i), tf);
+        do_not_optimize(s);
+      }
+    }});
+  }
+
+  // ranger-can reads the first 5 distances of each ranger-u JSONL line
+  for (long long n : {5LL, 16LL, 64LL}){
+    cs.push_back({"parse_jsonl_line", {{"sensors", n}}, [n](uint64_t iters){
+      const std::string line = "{\"ts_ns\":123456789,\"data\":" + to_json(sample_frame(static_cast<size_t>(n))) + "}";
+      for (uint64_t i = 0; i < iters; i++){
+        auto a = parse_jsonl_line(line);
+        do_not_optimize(a);
+      }
+    }});
+  }
+
+  cs.push_back({"ranger_msg_pack", {}, [](uint64_t iters){
+    RangerMsg msg{};
+    std::array<float,5> d{1.0f, 1.6f, 0.8f, 2.2f, 0.35f};
+    for (uint64_t i = 0; i < iters; i++){
+      d[i % 5] += 1e-6f;
+      pack_ranger_msg(msg, d);
+      do_not_optimize(msg);
+    }
+  }});
+
+  return cs;
+}
+
+static std::map<std::string, std::string> context(){
+  std::map<std::string, std::string> c;
+  utsname u{};
+  if (uname(&u) == 0){
+    c["host"] = u.nodename;
+    c["kernel"] = u.release;
+    c["machine"] = u.machine;
+  }
+  c["cpus"] = std::to_string(sysconf(_SC_NPROCESSORS_ONLN));
+  c["compiler"] = __VERSION__;
+#ifdef RANGER_BENCH_BUILD_TYPE
+  c["build_type"] = RANGER_BENCH_BUILD_TYPE;
+#endif
+#if defined(__SANITIZE_ADDRESS__)
+  c["sanitizers"] = "address";
+#else
+  c["sanitizers"] = "none";
+#endif
+  return c;
+}
+
+int main(int argc, char** argv){
+  microbench::Options o;
+  std::string json;
+  bool list = false;
+  for (int i=1;i<argc;i++){
+    std::string k = argv[i];
+    auto need = [&](const char* name){ if (i+1>=argc) { std::cerr<<"Missing value for "<<name<<"\n"; std::exit(2);} return std::string(argv[++i]); };
+    if (k=="--filter") o.filter = need("--filter");
+    else if (k=="--reps") o.reps = std::stoi(need("--reps"));
+    else if (k=="--min-time-ms") o.min_time_ms = std::stod(need("--min-time-ms"));
+    else if (k=="--json") json = need("--json");
+    else if (k=="--list") list = true;
+    else if (k=="-h" || k=="--help"){
+      std::cout <<
+      "Usage: ranger-bench [--filter SUBSTR] [--reps 15] [--min-time-ms 20] [--json out.json|-] [--list]\n"
+      "Each case: calibrate a batch to min-time, one warmup batch, then reps timed batches.\n";
+      return 0;
+    }
+    else { std::cerr << "Unknown option " << k << "\n"; return 2; }
+  }
+  if (o.reps < 1) o.reps = 1;
+
+  auto ctx = context();
+  if (ctx["sanitizers"] != "none")
+    std::cerr << "[warn] built with sanitizers; configure with -DENABLE_ASAN=OFF for meaningful numbers\n";
+
+  // the table goes to stderr when JSON takes stdout
+  FILE* table = json == "-" ? stderr : stdout;
+  std::vector<microbench::Result> results;
+  if (!list) microbench::print_header(table);
+  for (const auto& c : make_cases()){
+    std::string name = microbench::full_name(c);
+    if (!o.filter.empty() && name.find(o.filter) == std::string::npos) continue;
+    if (list){ std::printf("%s\n", name.c_str()); continue; }
+    results.push_back(microbench::run(c, o));
+    microbench::print_row(table, results.back());
+    std::fflush(table);
+  }
+
+  if (!json.empty() && !microbench::write_json(json, ctx, results)){
+    std::cerr << "[!] cannot write " << json << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,428 @@
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * ranger-scale: sensor-count scaling driver (scripts/bench_scaling.sh)
+ * - bank: creates a gpio-sim device in configfs with one bank of N lines,
+ *   labelled "ranger-scale" (ranger_k sim_chip=), prints its gpiochipX;
+ *   unbank removes it.
+ * - run: drives all N lines with pulse_gen at --rate-hz for --duration while
+ *   one acquisition path consumes them:
+ *     u  ranger-u on libgpiod, one line request per sensor
+ *     k  ranger_k (loaded on the bank by the caller) + ranger-u --kring
+ *   and prints one row: edges in / seen / dropped, edges/s, CPU (ranger-u
+ *   user+sys, plus the ranger_k IRQ threads for k) and edge -> ranger-u
+ *   receive percentiles; --json appends the same as one JSON line.
+ */
+
+static constexpr int64_t kNs = 1000000000LL;
+static const std::string kConfigfs = "/sys/kernel/config/gpio-sim/";
+static const std::string kDebugfs = "/sys/kernel/debug/ranger_k/";
+static const std::string kKdev = "/sys/devices/platform/ranger_k/";
+
+struct Args {
+  std::string cmd;
+  std::string name = "ranger-scale";   // configfs device and bank label
+  int lines = 8;
+  std::string path = "u";
+  double rate_hz = 20.0;
+  int duration_s = 10;
+  double dist_m = 1.0;
+  int gen_rt = 0;                      // pulse_gen --rt
+  int gen_cpu = -1;                    // pulse_gen --cpu
+  std::string ranger_u, pulse_gen;     // default: next to this binary's build tree
+  std::string json;
+  std::string label;
+  bool header = false;
+};
+
+static void usage(const char* prog){
+  std::cerr << "Usage: " << prog << " bank --lines N [--name ranger-scale]\n"
+            << "       " << prog << " unbank [--name ranger-scale]\n"
+            << "       " << prog << " run --path u|k --lines N [--rate-hz 20] [--duration 10] [--dist 1.0]\n"
+            << "           [--gen-rt PRIO] [--gen-cpu N] [--ranger-u BIN] [--pulse-gen BIN]\n"
+            << "           [--json FILE (appended)] [--label NAME] [--header] [--name ranger-scale]\n";
+}
+
+static Args parse_args(int argc, char** argv){
+  Args a;
+  if (argc < 2) { usage(argv[0]); std::exit(2); }
+  a.cmd = argv[1];
+  for (int i=2;i<argc;i++){
+    std::string k = argv[i];
+    auto need = [&](const char* name){ if (i+1>=argc) { std::cerr<<"Missing value for "<<name<<"\n"; std::exit(2);} return std::string(argv[++i]); };
+    if (k=="--name") a.name = need("--name");
+    else if (k=="--lines") a.lines = std::stoi(need("--lines"));
+    else if (k=="--path") a.path = need("--path");
+    else if (k=="--rate-hz") a.rate_hz = std::stod(need("--rate-hz"));
+    else if (k=="--duration") a.duration_s = std::stoi(need("--duration"));
+    else if (k=="--dist") a.dist_m = std::stod(need("--dist"));
+    else if (k=="--gen-rt") a.gen_rt = std::stoi(need("--gen-rt"));
+    else if (k=="--gen-cpu") a.gen_cpu = std::stoi(need("--gen-cpu"));
+    else if (k=="--ranger-u") a.ranger_u = need("--ranger-u");
+    else if (k=="--pulse-gen") a.pulse_gen = need("--pulse-gen");
+    else if (k=="--json") a.json = need("--json");
+    else if (k=="--label") a.label = need("--label");
+    else if (k=="--header") a.header = true;
+    else if (k=="-h" || k=="--help"){ usage(argv[0]); std::exit(0); }
+    else { usage(argv[0]); std::exit(2); }
+  }
+  if (a.lines < 1) { std::cerr << "--lines must be >= 1\n"; std::exit(2); }
+  if (a.path != "u" && a.path != "k") { std::cerr << "--path must be u or k\n"; std::exit(2); }
+  return a;
+}
+
+static int64_t now_ns(){
+  timespec ts{};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * kNs + ts.tv_nsec;
+}
+
+static std::string read_file(const std::string& path){
+  std::ifstream f(path);
+  std::stringstream ss;
+  ss << f.rdbuf();
+  std::string s = ss.str();
+  while (!s.empty() && (s.back() == '\n' || s.back() == ' ')) s.pop_back();
+  return s;
+}
+
+static bool write_file(const std::string& path, const std::string& v){
+  std::ofstream f(path);
+  f << v;
+  f.flush();
+  if (!f) { std::cerr << "[!] write " << path << ": " << std::strerror(errno) << "\n"; return false; }
+  return true;
+}
+
+// === gpio-sim bank ===
+
+static int unbank(const Args& a){
+  const std::string dev = kConfigfs + a.name;
+  if (access(dev.c_str(), F_OK) != 0) return 0;
+  write_file(dev + "/live", "0");
+  if (rmdir((dev + "/bank0").c_str()) != 0 || rmdir(dev.c_str()) != 0){
+    std::cerr << "[!] rmdir " << dev << ": " << std::strerror(errno) << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+static int bank(const Args& a){
+  const std::string dev = kConfigfs + a.name;
+  if (unbank(a) != 0) return 1;
+  if (mkdir(dev.c_str(), 0755) != 0 || mkdir((dev + "/bank0").c_str(), 0755) != 0){
+    std::cerr << "[!] mkdir " << dev << ": " << std::strerror(errno)
+              << " (gpio-sim loaded, configfs mounted, root?)\n";
+    return 1;
+  }
+  if (!write_file(dev + "/bank0/num_lines", std::to_string(a.lines)) ||
+      !write_file(dev + "/bank0/label", a.name) ||
+      !write_file(dev + "/live", "1"))
+    return 1;
+  std::cout << read_file(dev + "/bank0/chip_name") << "\n";
+  return 0;
+}
+
+// sysfs dir holding sim_gpioN/pull for pulse_gen --chip
+static std::string chip_sysfs(const Args& a){
+  const std::string dev = kConfigfs + a.name;
+  return "/sys/devices/platform/" + read_file(dev + "/dev_name") + "/" + read_file(dev + "/bank0/chip_name");
+}
+
+// === processes ===
+
+static pid_t spawn(const std::vector<std::string>& argv, const std::string& err_path){
+  pid_t pid = fork();
+  if (pid < 0) { std::perror("fork"); std::exit(1); }
+  if (pid == 0){
+    int out = open("/dev/null", O_WRONLY);
+    int err = open(err_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out >= 0) dup2(out, STDOUT_FILENO);
+    if (err >= 0) dup2(err, STDERR_FILENO);
+    std::vector<char*> v;
+    for (auto& s : argv) v.push_back(const_cast<char*>(s.c_str()));
+    v.push_back(nullptr);
+    execv(v[0], v.data());
+    std::perror(v[0]);
+    _exit(127);
+  }
+  return pid;
+}
+
+static int wait_child(pid_t pid, rusage* ru){
+  int st = 0;
+  while (wait4(pid, &st, 0, ru) < 0 && errno == EINTR) {}
+  return WIFEXITED(st) ? WEXITSTATUS(st) : 128 + WTERMSIG(st);
+}
+
+static std::string self_dir(){
+  char buf[4096];
+  ssize_t n = readlink("/proc/self/exe", buf, sizeof(buf) - 1);
+  if (n <= 0) return ".";
+  std::string p(buf, n);
+  return p.substr(0, p.rfind('/'));
+}
+
+// "key=value" token from a stderr line that starts with prefix
+static double stderr_value(const std::string& path, const std::string& prefix, const std::string& key){
+  std::ifstream f(path);
+  std::string line;
+  double v = 0;
+  while (std::getline(f, line)){
+    if (line.compare(0, prefix.size(), prefix) != 0) continue;
+    size_t p = line.find(" " + key + "=");
+    if (p != std::string::npos) v = std::stod(line.substr(p + key.size() + 2));
+  }
+  return v;
+}
+
+// === ranger-u --stats ===
+
+struct StageRow { uint64_t count = 0, p50 = 0, p99 = 0, p999 = 0, max = 0; };
+struct UStats {
+  std::map<std::string, StageRow> stage;
+  uint64_t edges = 0, pulses = 0;
+};
+
+static UStats read_ustats(const std::string& path){
+  UStats u;
+  std::ifstream f(path);
+  std::string line;
+  bool sensors = false;
+  while (std::getline(f, line)){
+    if (line.rfind("# sensor", 0) == 0) { sensors = true; continue; }
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream is(line);
+    if (sensors){
+      uint64_t idx, edges, pulses;
+      if (is >> idx >> edges >> pulses) { u.edges += edges; u.pulses += pulses; }
+    } else {
+      std::string name;
+      StageRow r;
+      if (is >> name >> r.count >> r.p50 >> r.p99 >> r.p999 >> r.max) u.stage[name] = r;
+    }
+  }
+  return u;
+}
+
+// === ranger_k debugfs / sysfs ===
+
+// "seq=N nl_dropped=M pulses=a,b,... qdrops=..." -> sums per field
+static std::map<std::string, uint64_t> read_kstats(){
+  std::map<std::string, uint64_t> m;
+  std::istringstream is(read_file(kDebugfs + "stats"));
+  std::string tok;
+  while (is >> tok){
+    size_t eq = tok.find('=');
+    if (eq == std::string::npos) continue;
+    uint64_t sum = 0;
+    std::istringstream vs(tok.substr(eq + 1));
+    std::string v;
+    while (std::getline(vs, v, ',')) if (!v.empty()) sum += std::stoull(v);
+    m[tok.substr(0, eq)] = sum;
+  }
+  return m;
+}
+
+// irq_lat rows of "histograms" merged over sensors; bK counts [2^K, 2^(K+1)) ns
+static std::vector<uint64_t> read_irq_lat(){
+  std::vector<uint64_t> b(32, 0);
+  std::ifstream f(kDebugfs + "histograms");
+  std::string line;
+  while (std::getline(f, line)){
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream is(line);
+    std::string idx, kind;
+    uint64_t total, p50, p99, v;
+    if (!(is >> idx >> kind >> total >> p50 >> p99) || kind != "irq_lat") continue;
+    for (size_t k = 0; k < b.size() && is >> v; k++) b[k] += v;
+  }
+  return b;
+}
+
+static uint64_t log2_pct(const std::vector<uint64_t>& b, double q){
+  uint64_t n = 0, seen = 0;
+  for (auto c : b) n += c;
+  if (!n) return 0;
+  uint64_t rank = std::min<uint64_t>(static_cast<uint64_t>(q * n), n - 1);
+  for (size_t k = 0; k < b.size(); k++)
+    if ((seen += b[k]) > rank) return (2ull << k) - 1;
+  return 0;
+}
+
+// user+sys ns of the ranger_k IRQ threads (tid 0 = no interrupt yet)
+static int64_t irq_thread_cpu_ns(){
+  std::istringstream is(read_file(kKdev + "irq_tids"));
+  std::string tid;
+  int64_t ticks = 0;
+  while (std::getline(is, tid, ',')){
+    if (tid.empty() || tid == "0") continue;
+    std::string st = read_file("/proc/" + tid + "/stat");
+    size_t p = st.rfind(')');
+    if (p == std::string::npos) continue;
+    std::istringstream fs(st.substr(p + 2));
+    std::string f;
+    long long ut = 0, stt = 0;
+    for (int i = 3; i <= 15 && fs >> f; i++){
+      if (i == 14) ut = std::stoll(f);
+      if (i == 15) stt = std::stoll(f);
+    }
+    ticks += ut + stt;
+  }
+  return ticks * kNs / sysconf(_SC_CLK_TCK);
+}
+
+// === run ===
+
+static int run(const Args& a){
+  const std::string chip = read_file(kConfigfs + a.name + "/bank0/chip_name");
+  if (chip.empty()) { std::cerr << "[!] no gpio-sim bank '" << a.name << "' (run: ranger-scale bank)\n"; return 1; }
+  const std::string dir = self_dir();
+  const std::string ranger_u = a.ranger_u.empty() ? dir + "/../ranger-u/ranger-u" : a.ranger_u;
+  const std::string pulse_gen = a.pulse_gen.empty() ? dir + "/../tools/pulse_gen/pulse_gen" : a.pulse_gen;
+  const bool kpath = a.path == "k";
+
+  char tmpl[] = "/tmp/ranger-scale.XXXXXX";
+  if (!mkdtemp(tmpl)) { std::perror("mkdtemp"); return 1; }
+  const std::string tmp = tmpl;
+
+  // "0,1,..." and "0:D,1:D,...", appended piecewise into reserved buffers
+  const std::string dist = std::to_string(a.dist_m);
+  std::string lines, map;
+  lines.reserve(static_cast<size_t>(a.lines) * 5);
+  map.reserve(static_cast<size_t>(a.lines) * (6 + dist.size()));
+  for (int i = 0; i < a.lines; i++){
+    const std::string idx = std::to_string(i);
+    if (i){ lines.append(1, ','); map.append(1, ','); }
+    lines.append(idx);
+    map.append(idx).append(1, ':').append(dist);
+  }
+
+  std::map<std::string, uint64_t> k0;
+  int64_t irq0 = 0;
+  if (kpath){
+    if (access((kDebugfs + "stats").c_str(), R_OK) != 0){
+      std::cerr << "[!] " << kDebugfs << "stats not readable (ranger_k loaded? debugfs mounted?)\n";
+      return 1;
+    }
+    k0 = read_kstats();
+    irq0 = irq_thread_cpu_ns();
+    write_file(kDebugfs + "histograms", "0");
+  }
+
+  // consumer first, so it owns the lines (or the ring) before the first edge
+  std::vector<std::string> uargv = { ranger_u, "--lines", lines, "--duration", std::to_string(a.duration_s + 2),
+                                     "--stats", tmp + "/ustats", "--jsonl", "/dev/null" };
+  if (kpath) { uargv.push_back("--kring"); uargv.push_back("/dev/ranger_k"); }
+  else { uargv.push_back("--chip"); uargv.push_back("/dev/" + chip); }
+  const int64_t t_u = now_ns();
+  pid_t upid = spawn(uargv, tmp + "/ranger-u.err");
+  usleep(500000);
+
+  std::vector<std::string> gargv = { pulse_gen, map, "--chip", chip_sysfs(a), "--rate-hz", std::to_string(a.rate_hz),
+                                     "--duration", std::to_string(a.duration_s) };
+  if (a.gen_rt > 0) { gargv.push_back("--rt"); gargv.push_back(std::to_string(a.gen_rt)); }
+  if (a.gen_cpu >= 0) { gargv.push_back("--cpu"); gargv.push_back(std::to_string(a.gen_cpu)); }
+  const int64_t t_g = now_ns();
+  pid_t gpid = spawn(gargv, tmp + "/pulse_gen.err");
+  int grc = wait_child(gpid, nullptr);
+  const double gen_s = (now_ns() - t_g) / 1e9;
+
+  rusage ru{};
+  int urc = wait_child(upid, &ru);
+  const double u_s = (now_ns() - t_u) / 1e9;
+
+  const uint64_t edges_in = static_cast<uint64_t>(stderr_value(tmp + "/pulse_gen.err", "[i] edges=", "edges"));
+  const double gen_late_max_us = stderr_value(tmp + "/pulse_gen.err", "[i] edges=", "late_max_us");
+  UStats us = read_ustats(tmp + "/ustats");
+
+  int64_t cpu_ns = (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * kNs +
+                   (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000LL;
+  uint64_t seen = us.edges, qdrops = 0, ring_dropped = 0, pulses_out = us.pulses;
+  StageRow recv = us.stage["edge_recv"];
+  std::vector<uint64_t> irq_lat;
+  if (kpath){
+    auto k1 = read_kstats();
+    auto d = [&](const char* f){ return k1[f] - k0[f]; };
+    pulses_out = d("pulses");
+    seen = 2 * d("pulses");  // edges that ended up in a measurement
+    qdrops = d("qdrops");
+    ring_dropped = static_cast<uint64_t>(stderr_value(tmp + "/ranger-u.err", "# kring", "dropped"));
+    cpu_ns += irq_thread_cpu_ns() - irq0;
+    irq_lat = read_irq_lat();
+  }
+  const uint64_t dropped = edges_in > seen ? edges_in - seen : 0;
+  const double cpu_pct = u_s > 0 ? 100.0 * cpu_ns / (u_s * 1e9) : 0.0;
+  const double cpu_per_edge = seen ? static_cast<double>(cpu_ns) / seen : 0.0;
+  // a failed child or an empty row: leave the child logs and ustats for a look
+  const bool keep = grc != 0 || urc != 0 || edges_in == 0 || seen == 0;
+  if (keep)
+    std::cerr << "[warn] pulse_gen exit " << grc << ", ranger-u exit " << urc << ", edges_in " << edges_in
+              << ", seen " << seen << " (kept " << tmp << ")\n";
+
+  if (a.header)
+    std::printf("%-5s %5s %6s %9s %9s %9s %8s %7s %9s %9s %9s %9s %9s %9s\n", "path", "lines", "rate", "edges_in",
+                "edges/s", "seen", "dropped", "cpu%", "cpu_ns/e", "recv_p50", "recv_p99", "recv_p999", "recv_max",
+                "gen_late");
+  std::printf("%-5s %5d %6.0f %9llu %9.0f %9llu %8llu %7.1f %9.0f %9llu %9llu %9llu %9llu %9.0f\n",
+              a.path.c_str(), a.lines, a.rate_hz, (unsigned long long)edges_in, gen_s > 0 ? edges_in / gen_s : 0.0,
+              (unsigned long long)seen, (unsigned long long)dropped, cpu_pct, cpu_per_edge,
+              (unsigned long long)recv.p50, (unsigned long long)recv.p99, (unsigned long long)recv.p999,
+              (unsigned long long)recv.max, gen_late_max_us);
+
+  if (!a.json.empty()){
+    FILE* f = std::fopen(a.json.c_str(), "a");
+    if (!f) { std::perror("open json"); return 1; }
+    std::fprintf(f, "{\"label\": \"%s\", \"path\": \"%s\", \"lines\": %d, \"rate_hz\": %.1f, \"duration_s\": %d, "
+                    "\"edges_in\": %llu, \"edges_per_s\": %.1f, \"edges_seen\": %llu, \"dropped\": %llu, "
+                    "\"pulses_out\": %llu, \"cpu_ns\": %lld, \"cpu_pct\": %.2f, \"cpu_ns_per_edge\": %.1f, "
+                    "\"recv_ns\": {\"count\": %llu, \"p50\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu}, "
+                    "\"gen_late_max_us\": %.1f",
+                 a.label.c_str(), a.path.c_str(), a.lines, a.rate_hz, a.duration_s, (unsigned long long)edges_in,
+                 gen_s > 0 ? edges_in / gen_s : 0.0, (unsigned long long)seen, (unsigned long long)dropped,
+                 (unsigned long long)pulses_out, (long long)cpu_ns, cpu_pct, cpu_per_edge,
+                 (unsigned long long)recv.count, (unsigned long long)recv.p50, (unsigned long long)recv.p99,
+                 (unsigned long long)recv.p999, (unsigned long long)recv.max, gen_late_max_us);
+    if (kpath)
+      std::fprintf(f, ", \"qdrops\": %llu, \"ring_dropped\": %llu, \"irq_lat_ns\": {\"p50\": %llu, \"p99\": %llu, \"p999\": %llu}",
+                   (unsigned long long)qdrops, (unsigned long long)ring_dropped,
+                   (unsigned long long)log2_pct(irq_lat, 0.50), (unsigned long long)log2_pct(irq_lat, 0.99),
+                   (unsigned long long)log2_pct(irq_lat, 0.999));
+    std::fprintf(f, "}\n");
+    std::fclose(f);
+  }
+
+  if (!keep){
+    unlink((tmp + "/ustats").c_str());
+    unlink((tmp + "/ranger-u.err").c_str());
+    unlink((tmp + "/pulse_gen.err").c_str());
+    rmdir(tmp.c_str());
+  }
+  return 0;
+}
+
+int main(int argc, char** argv){
+  auto args = parse_args(argc, argv);
+  if (args.cmd == "bank") return bank(args);
+  if (args.cmd == "unbank") return unbank(args);
+  if (args.cmd == "run") return run(args);
+  usage(argv[0]);
+  return 2;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// ISO-TP payload (little-endian, packed)
+#pragma pack(push,1)
+struct RangerMsg {
+  uint32_t seq;
+  float dist_m[5];
+  uint32_t status; // reserved
+};
+
+// --with-ts payload: RangerMsg followed by the CLOCK_MONOTONIC stage stamps
+// of the oldest fresh measurement in the frame (all 0 if none was fresh)
+struct RangerMsgTs {
+  RangerMsg msg;
+  uint64_t edge_ns;    // falling edge (kernel stamp / replay injection)
+  uint64_t urecv_ns;   // ranger-u read the edge
+  uint64_t filt_ns;    // ranger-u median output
+  uint64_t out_ns;     // ranger-u handed the frame to its sink
+  uint64_t can_in_ns;  // ranger-can read the line
+  uint64_t can_tx_ns;  // ranger-can send()
+};
+#pragma pack(pop)
+
+// very small JSON parser: find the "d":[...] array and parse 5 floats.
+// Lines with fewer are rejected unless allow_partial (the rest are NaN then).
+std::optional<std::array<float,5>> parse_jsonl_line(const std::string& line, bool allow_partial = false);
+
+// ranger-u --with-ts stamps: "t":{"edge":E,"recv":R,"filt":F,"out":O}
+bool parse_jsonl_ts(const std::string& line, RangerMsgTs& ts);
+
+// fill msg from one parsed line; bumps msg.seq
+void pack_ranger_msg(RangerMsg& msg, const std::array<float,5>& d, uint32_t status = 0);
+
+// SocketCAN ISO-TP socket on ifname (padded frames); -1 on error (perror'd)
+int open_isotp(const std::string& ifname, uint32_t tx_id, uint32_t rx_id);
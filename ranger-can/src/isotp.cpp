@@ -0,0 +1,47 @@
+#include "ranger_can.hpp"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/isotp.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <cstdio>
+
+int open_isotp(const std::string& ifname, uint32_t tx_id, uint32_t rx_id){
+  int s = socket(PF_CAN, SOCK_DGRAM, CAN_ISOTP);
+  if (s < 0) { perror("socket CAN_ISOTP"); return -1; }
+
+  // Configure default ISO-TP options
+  struct can_isotp_options opts{};
+  opts.flags = CAN_ISOTP_TX_PADDING | CAN_ISOTP_RX_PADDING;
+  opts.txpad_content = 0x00;
+  opts.rxpad_content = 0x00;
+  if (setsockopt(s, SOL_CAN_ISOTP, CAN_ISOTP_OPTS, &opts, sizeof(opts)) < 0){
+    perror("setsockopt CAN_ISOTP_OPTS");
+    // not fatal
+  }
+
+  struct ifreq ifr{};
+  std::snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", ifname.c_str());
+  if (ioctl(s, SIOCGIFINDEX, &ifr) < 0){
+    perror("ioctl SIOCGIFINDEX");
+    close(s);
+    return -1;
+  }
+
+  struct sockaddr_can addr{};
+  addr.can_family = AF_CAN;
+  addr.can_ifindex = ifr.ifr_ifindex;
+  addr.can_addr.tp.tx_id = tx_id;
+  addr.can_addr.tp.rx_id = rx_id;
+
+  if (bind(s, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+    perror("bind isotp");
+    close(s);
+    return -1;
+  }
+  return s;
+}
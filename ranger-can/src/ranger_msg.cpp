@@ -0,0 +1,49 @@
+#include "ranger_can.hpp"
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+
+std::optional<std::array<float,5>> parse_jsonl_line(const std::string& line, bool allow_partial){
+  auto pos = line.find("\"d\"");
+  if (pos == std::string::npos) return std::nullopt;
+  pos = line.find('[', pos);
+  if (pos == std::string::npos) return std::nullopt;
+  auto end = line.find(']', pos);
+  if (end == std::string::npos) return std::nullopt;
+  std::array<float,5> out;
+  out.fill(std::numeric_limits<float>::quiet_NaN());  // absent (allow_partial), never a 0 m reading
+  size_t idx = 0;
+  std::string arr = line.substr(pos+1, end-pos-1); // inside [ ... ]
+  std::stringstream ss(arr);
+  std::string tok;
+  while (std::getline(ss, tok, ',') && idx < 5){
+    try { out[idx++] = std::stof(tok); } catch(...) { return std::nullopt; }
+  }
+  if (idx != 5 && !(allow_partial && idx > 0)) return std::nullopt;
+  return out;
+}
+
+static uint64_t json_u64(const std::string& obj, const char* key){
+  std::string k = std::string("\"") + key + "\":";
+  auto p = obj.find(k);
+  return p == std::string::npos ? 0 : std::strtoull(obj.c_str() + p + k.size(), nullptr, 10);
+}
+
+bool parse_jsonl_ts(const std::string& line, RangerMsgTs& ts){
+  auto pos = line.find("\"t\":{");
+  if (pos == std::string::npos) return false;
+  auto end = line.find('}', pos);
+  if (end == std::string::npos) return false;
+  std::string obj = line.substr(pos + 4, end - pos - 3);
+  ts.edge_ns = json_u64(obj, "edge");
+  ts.urecv_ns = json_u64(obj, "recv");
+  ts.filt_ns = json_u64(obj, "filt");
+  ts.out_ns = json_u64(obj, "out");
+  return ts.edge_ns != 0;
+}
+
+void pack_ranger_msg(RangerMsg& msg, const std::array<float,5>& d, uint32_t status){
+  msg.seq++;
+  for (size_t i=0;i<5;i++) msg.dist_m[i] = d[i];
+  msg.status = status;
+}
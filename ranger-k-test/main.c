@@ -1,18 +1,217 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/genetlink.h>
 
-int main(void){
-  FILE* f = fopen("/sys/kernel/debug/ranger_k/distances", "r");
+#include "ranger_k_uapi.h"
+
+#define DBG_DIR "/sys/kernel/debug/ranger_k/"
+
+/* Print one binary snapshot; returns 0 on success */
+static int print_snapshot(int fd){
+  _Alignas(8) unsigned char buf[sizeof(struct rk_snapshot) + RK_MAX_SENSORS * sizeof(struct rk_snapshot_sensor)];
+  ssize_t n = pread(fd, buf, sizeof(buf), 0);
+  if (n < (ssize_t)sizeof(struct rk_snapshot)){ perror("read snapshot"); return -1; }
+  const struct rk_snapshot* h = (const struct rk_snapshot*)buf;
+  if (h->version < RK_SNAPSHOT_VERSION){ fprintf(stderr, "snapshot version %u\n", h->version); return -1; }
+  printf("snapshot: seq=%u updates=%u", h->seq, h->updates);
+  for (int filt = 0; filt < 2; filt++){
+    printf(filt ? " f=[" : " d=[");
+    for (unsigned i = 0; i < h->nsensors; i++){
+      size_t off = h->hdr_size + (size_t)i * h->sensor_size;
+      if (off + sizeof(struct rk_snapshot_sensor) > (size_t)n) break;
+      const struct rk_snapshot_sensor* s = (const struct rk_snapshot_sensor*)(buf + off);
+      unsigned um = filt ? s->filt_um : s->dist_um;
+      printf("%s%u.%03u", i ? "," : "", um / 1000000u, (um / 1000u) % 1000u);
+    }
+    printf("]");
+  }
+  printf("\n");
+  return 0;
+}
+
+/* Block for N frames and print each with its completeness mask */
+static int print_frames(int count){
+  int fd = open(DBG_DIR "frame", O_RDONLY);
+  if (fd < 0){ perror("open frame"); return 1; }
+  for (int i = 0; i < count; i++){
+    struct pollfd p = { .fd = fd, .events = POLLIN };
+    int r = poll(&p, 1, 2000);
+    if (r < 0){ perror("poll"); break; }
+    if (r == 0){ printf("frame: none for 2 s\n"); continue; }
+    _Alignas(8) unsigned char buf[sizeof(struct rk_frame) + RK_MAX_SENSORS * sizeof(struct rk_frame_sensor)];
+    ssize_t n = pread(fd, buf, sizeof(buf), 0);
+    if (n < (ssize_t)sizeof(struct rk_frame)){ perror("read frame"); break; }
+    const struct rk_frame* f = (const struct rk_frame*)buf;
+    printf("frame %u: start=%llu span_us=%llu mask=0x%llx d=[", f->seq,
+           (unsigned long long)f->ts_ns, (unsigned long long)(f->pub_ns - f->ts_ns) / 1000ull,
+           (unsigned long long)f->mask);
+    for (unsigned k = 0; k < f->nsensors; k++){
+      size_t off = f->hdr_size + (size_t)k * f->sensor_size;
+      if (off + sizeof(struct rk_frame_sensor) > (size_t)n) break;
+      const struct rk_frame_sensor* s = (const struct rk_frame_sensor*)(buf + off);
+      if (f->mask & (1ull << k))
+        printf("%s%u.%03u", k ? "," : "", s->filt_um / 1000000u, (s->filt_um / 1000u) % 1000u);
+      else
+        printf("%s-", k ? "," : "");
+    }
+    printf("]\n");
+  }
+  close(fd);
+  return 0;
+}
+
+/* === generic netlink (raw sockets, no libnl) === */
+#define NLA_DATA(a) ((void*)((char*)(a) + NLA_HDRLEN))
+#define NL_BUF 16384
+
+static int nl_attrs(const struct genlmsghdr* g, int len, void (*fn)(const struct nlattr*, void*), void* arg){
+  const struct nlattr* a = (const struct nlattr*)((const char*)g + GENL_HDRLEN);
+  len -= GENL_HDRLEN;
+  while (len >= (int)NLA_HDRLEN && a->nla_len >= NLA_HDRLEN && a->nla_len <= len){
+    fn(a, arg);
+    len -= NLA_ALIGN(a->nla_len);
+    a = (const struct nlattr*)((const char*)a + NLA_ALIGN(a->nla_len));
+  }
+  return 0;
+}
+
+struct family_ids { int family; int group; };
+
+static void family_attr(const struct nlattr* a, void* arg){
+  struct family_ids* ids = arg;
+  if ((a->nla_type & NLA_TYPE_MASK) == CTRL_ATTR_FAMILY_ID) ids->family = *(const __u16*)NLA_DATA(a);
+  if ((a->nla_type & NLA_TYPE_MASK) != CTRL_ATTR_MCAST_GROUPS) return;
+  /* nested: [ {ID, NAME}, ... ] */
+  const struct nlattr* grp = NLA_DATA(a);
+  int left = a->nla_len - NLA_HDRLEN;
+  while (left >= (int)NLA_HDRLEN && grp->nla_len >= NLA_HDRLEN && grp->nla_len <= left){
+    const struct nlattr* f = NLA_DATA(grp);
+    int fl = grp->nla_len - NLA_HDRLEN, id = -1;
+    const char* name = NULL;
+    while (fl >= (int)NLA_HDRLEN && f->nla_len >= NLA_HDRLEN && f->nla_len <= fl){
+      if (f->nla_type == CTRL_ATTR_MCAST_GRP_ID) id = *(const __u32*)NLA_DATA(f);
+      if (f->nla_type == CTRL_ATTR_MCAST_GRP_NAME) name = NLA_DATA(f);
+      fl -= NLA_ALIGN(f->nla_len);
+      f = (const struct nlattr*)((const char*)f + NLA_ALIGN(f->nla_len));
+    }
+    if (name && !strcmp(name, RK_GENL_MCGRP)) ids->group = id;
+    left -= NLA_ALIGN(grp->nla_len);
+    grp = (const struct nlattr*)((const char*)grp + NLA_ALIGN(grp->nla_len));
+  }
+}
+
+/* CTRL_CMD_GETFAMILY "ranger_k" -> family id + "measure" group id */
+static int nl_resolve(int fd, struct family_ids* ids){
+  struct { struct nlmsghdr n; struct genlmsghdr g; char attrs[64]; } req;
+  memset(&req, 0, sizeof(req));
+  struct nlattr* a = (struct nlattr*)req.attrs;
+  a->nla_type = CTRL_ATTR_FAMILY_NAME;
+  a->nla_len = NLA_HDRLEN + sizeof(RK_GENL_NAME);
+  memcpy(NLA_DATA(a), RK_GENL_NAME, sizeof(RK_GENL_NAME));
+  req.n.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN + NLA_ALIGN(a->nla_len));
+  req.n.nlmsg_type = GENL_ID_CTRL;
+  req.n.nlmsg_flags = NLM_F_REQUEST;
+  req.g.cmd = CTRL_CMD_GETFAMILY;
+  req.g.version = 1;
+  if (send(fd, &req, req.n.nlmsg_len, 0) < 0){ perror("send"); return -1; }
+
+  _Alignas(4) char buf[NL_BUF];
+  ssize_t n = recv(fd, buf, sizeof(buf), 0);
+  if (n < 0){ perror("recv"); return -1; }
+  struct nlmsghdr* h = (struct nlmsghdr*)buf;
+  if (!NLMSG_OK(h, n) || h->nlmsg_type == NLMSG_ERROR){
+    fprintf(stderr, "genl family '%s' not found (module loaded?)\n", RK_GENL_NAME);
+    return -1;
+  }
+  ids->family = ids->group = -1;
+  nl_attrs(NLMSG_DATA(h), h->nlmsg_len - NLMSG_HDRLEN, family_attr, ids);
+  return (ids->family < 0 || ids->group < 0) ? -1 : 0;
+}
+
+static void print_rec_attr(const struct nlattr* a, void* arg){
+  unsigned* count = arg;
+  if (a->nla_type != RK_GENL_A_REC || a->nla_len < NLA_HDRLEN + sizeof(struct rk_rec)) return;
+  struct rk_rec r;
+  memcpy(&r, NLA_DATA(a), sizeof(r));
+  printf("rec: seq=%u sensor=%u d=%u.%03u f=%u.%03u width_ns=%u flags=0x%x\n", r.seq, r.sensor,
+         r.dist_um / 1000000u, (r.dist_um / 1000u) % 1000u,
+         r.filt_um / 1000000u, (r.filt_um / 1000u) % 1000u, r.width_ns, r.flags);
+  (*count)++;
+}
+
+/* Join the multicast group and print N records */
+static int nl_listen(int count){
+  int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+  if (fd < 0){ perror("socket"); return 1; }
+  struct sockaddr_nl sa = { .nl_family = AF_NETLINK };
+  if (bind(fd, (struct sockaddr*)&sa, sizeof(sa)) < 0){ perror("bind"); close(fd); return 1; }
+  struct family_ids ids;
+  if (nl_resolve(fd, &ids)){ close(fd); return 1; }
+  if (setsockopt(fd, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP, &ids.group, sizeof(ids.group)) < 0){
+    perror("NETLINK_ADD_MEMBERSHIP"); close(fd); return 1;
+  }
+  printf("netlink: family %d, group %s=%d\n", ids.family, RK_GENL_MCGRP, ids.group);
+
+  unsigned seen = 0;
+  _Alignas(4) char buf[NL_BUF];
+  while (seen < (unsigned)count){
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n < 0){ perror("recv"); break; }
+    for (struct nlmsghdr* h = (struct nlmsghdr*)buf; NLMSG_OK(h, n); h = NLMSG_NEXT(h, n)){
+      if (h->nlmsg_type != ids.family) continue;
+      nl_attrs(NLMSG_DATA(h), h->nlmsg_len - NLMSG_HDRLEN, print_rec_attr, &seen);
+    }
+  }
+  close(fd);
+  return 0;
+}
+
+/* Usage: ranger-k-test [N]
+ *        ranger-k-test nl [N]     (print N records from the netlink group)
+ *        ranger-k-test frame [N]  (print N cycle-coherent frames)
+ * Prints the text files once, then N snapshots, blocking in poll() until
+ * the module publishes new data between them.
+ */
+int main(int argc, char** argv){
+  if (argc > 1 && !strcmp(argv[1], "nl"))
+    return nl_listen((argc > 2) ? atoi(argv[2]) : 10);
+  if (argc > 1 && !strcmp(argv[1], "frame"))
+    return print_frames((argc > 2) ? atoi(argv[2]) : 10);
+  int count = (argc > 1) ? atoi(argv[1]) : 1;
+
+  FILE* f = fopen(DBG_DIR "distances", "r");
   if (!f){ perror("open distances"); return 1; }
-  char buf[256] = {0};
+  char buf[512] = {0};
   if (fgets(buf, sizeof(buf), f)){
     printf("distances: %s", buf);
   }
   fclose(f);
-  f = fopen("/sys/kernel/debug/ranger_k/stats", "r");
+  f = fopen(DBG_DIR "filtered", "r");
+  if (f && fgets(buf, sizeof(buf), f)){
+    printf("filtered: %s", buf);
+    fclose(f);
+  }
+  f = fopen(DBG_DIR "stats", "r");
   if (f && fgets(buf, sizeof(buf), f)){
     printf("stats: %s", buf);
     fclose(f);
   }
+
+  int fd = open(DBG_DIR "snapshot", O_RDONLY);
+  if (fd < 0){ perror("open snapshot"); return 1; }
+  for (int i = 0; i < count; i++){
+    struct pollfd p = { .fd = fd, .events = POLLIN };
+    int r = poll(&p, 1, 2000);
+    if (r < 0){ perror("poll"); break; }
+    if (r == 0){ printf("snapshot: no new data for 2 s\n"); continue; }
+    if (print_snapshot(fd)) break;
+  }
+  close(fd);
   return 0;
 }
@@ -3,12 +3,43 @@
  * ranger_k - IRQ/timestamp MVP (gpio-sim + threaded IRQ)
  *
  * Summary:
- * - Uses five ECHO lines specified by legacy GPIO numbers via module param
- *   line_gpios=..., or auto-selects 768..772 when a gpio-sim chip with
- *   label "gpio-sim.0-node0" is present.
- * - Explicitly requests lines as inputs (gpio_request_one).
- * - Attaches a threaded IRQ on both edges; the handler measures pulse width
- *   and converts it to distance (micrometers), exposing data via debugfs.
+ * - A platform driver; the sensor count is the number of ECHO lines found
+ *   at probe (up to MAX_SENSORS) and all per-sensor state is allocated
+ *   then. Lines come from the "echo" GPIO array of the device: a DT node
+ *   (compatible "omnirevolve,ranger-k", echo-gpios = <...>), or the
+ *   module's own "ranger_k" device with a lookup table for sim_lines lines
+ *   of chip sim_chip (gpio-sim by default). Legacy GPIO numbers via
+ *   line_gpios=... are still accepted instead.
+ * - Optional TRIG outputs (the device's "trig" array): 10 us pulses from an
+ *   hrtimer (or an hrtimer-paced RT kthread when the chip can sleep) in
+ *   simultaneous, round-robin or interleaved-group slots. Echoes are then
+ *   paired with their own trigger; a rise without one is crosstalk.
+ * - Optional e-stop output (the device's "estop" line): every measurement
+ *   is compared with per-sensor stop/clear thresholds in the IRQ thread and
+ *   the line is asserted while any sensor is inside its stop distance.
+ * - A line firing faster than storm_rate edges/s is shut off for
+ *   storm_backoff_ms and flagged faulty, so a floating input cannot starve
+ *   the other sensors; it re-arms by itself.
+ * - Attaches a threaded IRQ on both edges. The hard handler timestamps each
+ *   edge into a per-sensor FIFO; the thread classifies edges by toggling
+ *   the tracked line level (resynchronized against the sampled level),
+ *   measures pulse width and converts it to distance (micrometers),
+ *   exposing data via debugfs.
+ * - Each sensor keeps a short window of recent distances; the thread
+ *   publishes an integer median (optionally outlier-gated) next to the
+ *   raw value, so every consumer sees the same filtered distance.
+ * - Every measurement is also appended to an mmap'able record ring on
+ *   /dev/ranger_k (layout in ranger_k_uapi.h) for zero-copy consumers.
+ * - Measurements are also assembled into frames, one per trigger cycle
+ *   (or per frame_window_us), each with a completeness mask and one start
+ *   timestamp, and published whole through debugfs "frame".
+ * - The same records are multicast on generic netlink family "ranger_k",
+ *   group "measure" (singly or batched), for any number of subscribers.
+ * - Each sensor's IRQ CPU and IRQ-thread SCHED_FIFO priority can be set
+ *   per sensor (irq_cpus / irq_prio), at load time or through sysfs.
+ * - Built with RANGER_K_IIO=y, also registers an IIO device: one distance
+ *   channel per sensor plus a timestamp, fed through a triggered kfifo
+ *   buffer that fires on every completed measurement.
  */
 
 #include <linux/module.h>
@@ -26,298 +57,2331 @@
 #include <linux/types.h>
 #include <linux/printk.h>
 #include <linux/irq.h>
+#include <linux/miscdevice.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/log2.h>
+#include <linux/atomic.h>
+#include <linux/overflow.h>
+#include <linux/platform_device.h>
+#include <linux/version.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/hrtimer.h>
+#include <linux/gpio/machine.h>   /* gpiod lookup table for the gpio-sim device */
+#include <linux/mod_devicetable.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/bitmap.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/kref.h>
+#include <linux/irq_work.h>
+#include <linux/property.h>
+#include <net/genetlink.h>
+#ifdef RANGER_K_IIO
+#include <linux/iio/iio.h>
+#include <linux/iio/buffer.h>
+#include <linux/iio/trigger.h>
+#include <linux/iio/trigger_consumer.h>
+#include <linux/iio/triggered_buffer.h>
+#endif
+
+#include "ranger_k_uapi.h"
+
+#define CREATE_TRACE_POINTS
+#include "ranger_k_trace.h"
 
 #define DRV_NAME    "ranger_k"
-#define MAX_SENSORS 5
+#define MAX_SENSORS RK_MAX_SENSORS  /* upper bound; the actual count is g.n, set at probe */
+#define EDGE_FIFO   16  /* per-sensor hard-IRQ -> thread edge queue, power of two */
+#define HIST_BUCKETS 32 /* log2(ns) buckets: [2^k, 2^(k+1)) */
+#define FILT_MAX    15  /* largest median window */
+#define NL_BATCH_MAX 64 /* records per netlink message */
+#define STORM_WINDOW_MS 100 /* edge-rate measurement window */
+
+/* Module parameters:
+ * By default the module creates its own "ranger_k" device whose "echo" lines
+ * are lines 0..sim_lines-1 of chip sim_chip; probing waits until that chip
+ * exists. line_gpios=... (legacy numbers, one per sensor) replaces the
+ * lookup table. A DT node binds the driver the usual way.
+ */
+static int line_gpios[MAX_SENSORS];
+static int n_line_gpios;
+module_param_array(line_gpios, int, &n_line_gpios, 0444);
+MODULE_PARM_DESC(line_gpios, "Legacy GPIO numbers for ECHO lines, one per sensor (overrides sim_chip)");
+
+static char *sim_chip = "gpio-sim.0-node0";
+module_param(sim_chip, charp, 0444);
+MODULE_PARM_DESC(sim_chip, "GPIO chip label for the module's own device (default gpio-sim.0-node0, empty = none)");
+
+static unsigned int sim_lines = 5;
+module_param(sim_lines, uint, 0444);
+MODULE_PARM_DESC(sim_lines, "Sensors on sim_chip, lines 0..N-1 (default 5, max " __stringify(MAX_SENSORS) ")");
+
+static char *sim_trig_chip = "";
+module_param(sim_trig_chip, charp, 0444);
+MODULE_PARM_DESC(sim_trig_chip, "GPIO chip label for TRIG outputs of the own device (default none)");
+
+static unsigned int sim_trig_offset;
+module_param(sim_trig_offset, uint, 0444);
+MODULE_PARM_DESC(sim_trig_offset, "First TRIG line on sim_trig_chip; sensor i uses offset + i");
+
+static char *sim_estop_chip = "";
+module_param(sim_estop_chip, charp, 0444);
+MODULE_PARM_DESC(sim_estop_chip, "GPIO chip label for the e-stop output of the own device (default none)");
+
+static unsigned int sim_estop_line;
+module_param(sim_estop_line, uint, 0444);
+MODULE_PARM_DESC(sim_estop_line, "E-stop line offset on sim_estop_chip");
+
+/* Stop thresholds (filtered distance) */
+static unsigned int stop_mm[MAX_SENSORS];
+module_param_array(stop_mm, uint, NULL, 0444);
+MODULE_PARM_DESC(stop_mm, "Per-sensor stop distance in mm, 0 = off (default)");
+
+static unsigned int stop_hyst_mm = 50;
+module_param(stop_hyst_mm, uint, 0444);
+MODULE_PARM_DESC(stop_hyst_mm, "A stopped sensor clears above stop_mm + this (default 50)");
+
+/* Trigger schedule (only with TRIG lines) */
+static char *trig_mode = "rr";
+module_param(trig_mode, charp, 0444);
+MODULE_PARM_DESC(trig_mode, "sim = all at once, rr = one sensor per slot, groups = trig_groups interleaved groups");
+
+static unsigned int trig_groups = 2;
+module_param(trig_groups, uint, 0444);
+MODULE_PARM_DESC(trig_groups, "Groups for trig_mode=groups; sensor i fires in slot i % trig_groups");
+
+static unsigned int trig_period_us = 30000;
+module_param(trig_period_us, uint, 0444);
+MODULE_PARM_DESC(trig_period_us, "Time between trigger slots in us (default 30000)");
+
+static unsigned int trig_pulse_us = 10;
+module_param(trig_pulse_us, uint, 0444);
+MODULE_PARM_DESC(trig_pulse_us, "TRIG pulse width in us (default 10)");
+
+static unsigned int echo_timeout_us[MAX_SENSORS] = { [0 ... MAX_SENSORS - 1] = 25000 };
+module_param_array(echo_timeout_us, uint, NULL, 0444);
+MODULE_PARM_DESC(echo_timeout_us, "Per-sensor maximum echo time in us, 0 = off (default 25000, ~4.3 m)");
+
+static unsigned int filter_window = 5;
+module_param(filter_window, uint, 0444);
+MODULE_PARM_DESC(filter_window, "Median window per sensor, odd, 1.." __stringify(FILT_MAX) " (default 5, 1 = off)");
+
+static unsigned int outlier_um;
+module_param(outlier_um, uint, 0444);
+MODULE_PARM_DESC(outlier_um, "Reject samples this far from the current median, 0 = off (default)");
+
+static unsigned int nl_batch = 1;
+module_param(nl_batch, uint, 0444);
+MODULE_PARM_DESC(nl_batch, "Records per netlink message, 1.." __stringify(NL_BATCH_MAX) " (default 1 = every measurement)");
+
+static unsigned int nl_flush_ms = 10;
+module_param(nl_flush_ms, uint, 0444);
+MODULE_PARM_DESC(nl_flush_ms, "Send a partial netlink batch after this long (default 10)");
+
+static unsigned int storm_rate = 2000;
+module_param(storm_rate, uint, 0444);
+MODULE_PARM_DESC(storm_rate, "Max edges/s per line before it is shut off, 0 = no limit (default 2000)");
+
+static unsigned int storm_backoff_ms = 1000;
+module_param(storm_backoff_ms, uint, 0444);
+MODULE_PARM_DESC(storm_backoff_ms, "How long a storming line stays off (default 1000)");
+
+static unsigned int frame_window_us;
+module_param(frame_window_us, uint, 0444);
+MODULE_PARM_DESC(frame_window_us, "Frame length in us; 0 = one frame per trigger cycle, 100000 without TRIG lines (default 0)");
+
+/* IRQ placement, also writable at runtime via sysfs irq_cpus / irq_prio */
+static int irq_cpus[MAX_SENSORS] = { [0 ... MAX_SENSORS - 1] = -1 };
+module_param_array(irq_cpus, int, NULL, 0444);
+MODULE_PARM_DESC(irq_cpus, "Per-sensor CPU for the echo IRQ and its thread, -1 = kernel default");
+
+static int irq_prio[MAX_SENSORS];
+module_param_array(irq_prio, int, NULL, 0444);
+MODULE_PARM_DESC(irq_prio, "Per-sensor IRQ thread SCHED_FIFO priority 1..99, 0 = kernel default (50), -1 = SCHED_OTHER");
+
+static unsigned int ring_pages = 16;
+module_param(ring_pages, uint, 0444);
+MODULE_PARM_DESC(ring_pages, "Data pages of the /dev/ranger_k record ring (rounded up to a power of two)");
+
+/* One edge as seen by the hard IRQ handler */
+struct edge_evt {
+	ktime_t ts;
+	s8 level;      /* sampled line level, or -1 if the chip can sleep */
+};
+
+struct sensor_state {
+	bool have_rise;
+	ktime_t rise_ts;
+	int level;     /* tracked line level, toggled on every edge */
+	ktime_t meas_ts; /* falling edge of the last measurement */
+	u32 dist_um;   /* last measured distance (micrometers) */
+	u32 filt_um;   /* median of win_um[] */
+	u32 win_um[FILT_MAX]; /* recent accepted distances, ring of filter_window */
+	u8 win_n, win_pos;
+	u8 rejects;    /* consecutive outliers */
+	u32 outliers;  /* samples rejected by the outlier gate */
+	u32 pulses;    /* successfully measured pulses */
+	u32 overruns;  /* falling edge without a prior rising edge */
+	u32 lost_fall; /* sampled high while tracked high: reclassified as rising */
+	u32 lost_rise; /* sampled low while tracked low: reclassified as falling */
+	u32 resyncs;   /* idle level check disagreed with tracked level */
+	u32 qdrops;    /* edges dropped because the FIFO was full */
+	u32 timeouts;  /* no falling edge within echo_timeout_us */
+	bool no_echo;  /* last cycle timed out */
+	bool late_fall; /* timed out or crosstalk rise: swallow the falling edge */
+	bool trig_armed; /* own trigger fired, echo rise not seen yet */
+	ktime_t trig_ts; /* last own trigger */
+	u32 trig_ns;   /* trigger -> echo rise of the pending echo */
+	u32 xtalk;     /* echo rises without an own trigger (rejected) */
+	bool faulty;   /* IRQ shut off after an edge storm, storm_work re-arms it */
+	u32 storms;    /* storm shutdowns */
+	ktime_t storm_end;       /* end of the current rate window (hard IRQ) */
+	unsigned int storm_edges; /* edges in the current window (hard IRQ) */
+	struct delayed_work storm_work;
+	bool stopping; /* inside stop_mm, not yet past the clear distance */
+	u32 stops;     /* stop threshold breaches */
+	struct hrtimer echo_timer;  /* armed at rise_ts + echo_timeout_us */
+	int irq;
+	int cpu;       /* irq_cpus setting, -1 = default */
+	int pin_req;   /* thread CPU when the irqchip has no affinity control */
+	int pin_cur;   /* ... as applied by the thread */
+	int prio_req;  /* irq_prio setting */
+	int prio_cur;  /* ... as applied by the thread */
+	pid_t tid;     /* IRQ thread, 0 until it first runs */
+	bool hw_level; /* level readable from hard IRQ context */
+	bool nested;   /* nested-threaded irqchip: our hard handler never runs */
+	struct gpio_desc *gdesc;
+
+	/* hard IRQ (producer) -> IRQ thread (consumer), lockless SPSC */
+	struct edge_evt fifo[EDGE_FIFO];
+	unsigned int fifo_head;
+	unsigned int fifo_tail;
+};
+
+/* Per-CPU, per-sensor log2 histograms (summed over CPUs on read). The
+ * counters only ever grow; a reset moves g.hist_base instead.
+ */
+struct sensor_hist {
+	u32 width[HIST_BUCKETS];  /* echo pulse width */
+	u32 lat[HIST_BUCKETS];    /* hard IRQ -> IRQ thread */
+};
+
+/* Record ring shared with userspace via mmap (see ranger_k_uapi.h) */
+/* Ring memory outlives the binding while /dev/ranger_k is still open (or
+ * mapped: the vma pins the file). One reference for the device, one per open.
+ */
+struct ring_mem {
+	struct kref ref;
+	void *base;               /* vmalloc_user(): header page + records */
+	bool gone;                /* device unbound: poll -> EPOLLERR, mmap -> -ENODEV */
+	atomic_t busy;            /* single consumer */
+};
+
+struct rec_ring {
+	struct ring_mem *mem;
+	void *base;               /* == mem->base while bound */
+	size_t size;
+	struct rk_ring_hdr *hdr;
+	struct rk_rec *recs;
+	u32 nrec;                 /* power of two */
+	u64 head;                 /* authoritative head; hdr->head is a copy */
+	wait_queue_head_t wq;     /* initialized once in module init */
+};
+
+static struct {
+	struct dentry *dbg_dir;
+	spinlock_t lock; /* protects s[], seq, updates and ring.head */
+	struct sensor_state *s;  /* [n], allocated at probe */
+	int n;
+	bool storm_off;  /* teardown: no more storm shutdowns */
+	u32 seq;         /* edges handled */
+	u32 updates;     /* measurements published */
+	wait_queue_head_t snap_wq;  /* debugfs pollers, woken on updates */
+	struct rec_ring ring;
+	struct sensor_hist __percpu *hist;  /* [n] per CPU */
+	struct sensor_hist *hist_base;      /* [n] sums at the last reset */
+	struct mutex hist_mtx;              /* hist_base: reset vs readers */
+	struct platform_device *pdev;  /* bound device: parent for /dev/ranger_k and IIO */
+	struct platform_device *own;   /* device created by the module (sim_chip / line_gpios) */
+	struct gpiod_lookup_table *lookup;
+	struct trig_sched {
+		struct gpio_desc **desc;  /* [n], NULL = no TRIG lines */
+		struct gpio_array *info;
+		bool cansleep;
+		unsigned int nslots, slot;
+		bool high;                /* pulse phase */
+		ktime_t slot_ts;          /* start of the current slot */
+		ktime_t next;             /* next step (absolute) */
+		struct hrtimer timer;     /* non-sleeping chips */
+		struct irq_work arm_work; /* trig_arm() for the hard timer */
+		unsigned int arm_slot;    /* slot raised at arm_ts, for arm_work */
+		ktime_t arm_ts;
+		struct task_struct *task; /* sleeping chips */
+		DECLARE_BITMAP(on, MAX_SENSORS);
+		DECLARE_BITMAP(off, MAX_SENSORS);
+	} trig;
+	struct {
+		struct gpio_desc *desc;   /* NULL = thresholds only (flags, events) */
+		int active;               /* sensors stopping; under g.lock */
+		bool dirty;               /* active crossed zero; under g.lock */
+		struct mutex mtx;         /* serializes line writes, protects out */
+		bool out;                 /* current line state */
+	} estop;
+	struct {
+		struct rk_frame *cur;     /* being filled; under g.lock */
+		struct rk_frame *pub;     /* last complete frame; under g.lock */
+		size_t size;
+		u64 all;                  /* mask with every sensor set */
+		u32 seq;                  /* frames published */
+		bool window;              /* time windows instead of trigger cycles */
+		ktime_t period;           /* window length */
+		struct hrtimer timer;     /* window mode */
+		wait_queue_head_t wq;
+	} frame;
+	struct {
+		bool registered;
+		struct rk_rec q[NL_BATCH_MAX];  /* pending records; under g.lock */
+		unsigned int n;
+		u32 dropped;                    /* queue full; under g.lock */
+		struct rk_rec out[NL_BATCH_MAX];/* flush copy; under mtx */
+		struct mutex mtx;
+		struct delayed_work dwork;      /* flushes partial batches */
+	} nl;
+#ifdef RANGER_K_IIO
+	struct {
+		struct iio_dev *indio;
+		struct iio_trigger *trig;
+		struct iio_chan_spec *chans;
+		unsigned long *scan_masks;
+		u32 *scan;   /* u32 per sensor, then an aligned s64 timestamp */
+	} iio;
+#endif
+} g;
+
+/* ns -> um: distance_um = t * 171500 / 1e6
+ * (speed of sound ≈ 343 m/s, divide by 2 for round trip)
+ */
+static inline u32 width_ns_to_um(s64 width_ns)
+{
+	return (u32)div64_u64((u64)width_ns * 171500ULL, 1000000ULL);
+}
+
+/* Push one raw distance into the sensor window and return the median.
+ * A sample further than outlier_um from the current median is rejected
+ * (the median is kept) unless more than half a window of them arrive in a
+ * row, which means the target really moved: the window restarts there.
+ * Caller holds g.lock.
+ */
+static u32 sensor_filter(struct sensor_state *s, u32 raw)
+{
+	unsigned int w = filter_window;
+	u32 tmp[FILT_MAX];
+	int n;
+
+	if (outlier_um && s->win_n) {
+		u32 d = raw > s->filt_um ? raw - s->filt_um : s->filt_um - raw;
+
+		if (d > outlier_um) {
+			if (++s->rejects <= w / 2) {
+				s->outliers++;  /* held: only these count as rejected */
+				return s->filt_um;
+			}
+			s->win_n = 0;
+			s->win_pos = 0;
+		}
+	}
+	s->rejects = 0;
+	s->win_um[s->win_pos] = raw;
+	s->win_pos = s->win_pos + 1 < w ? s->win_pos + 1 : 0;
+	if (s->win_n < w)
+		s->win_n++;
+
+	/* Insertion sort: at most FILT_MAX entries, no allocation */
+	n = s->win_n;
+	for (int i = 0; i < n; i++) {
+		u32 v = s->win_um[i];
+		int j = i;
+
+		for (; j > 0 && tmp[j - 1] > v; j--)
+			tmp[j] = tmp[j - 1];
+		tmp[j] = v;
+	}
+	s->filt_um = tmp[n / 2];
+	return s->filt_um;
+}
+
+static void rk_hrtimer_setup(struct hrtimer *t, enum hrtimer_restart (*fn)(struct hrtimer *),
+                             enum hrtimer_mode mode)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+	hrtimer_setup(t, fn, CLOCK_MONOTONIC, mode);
+#else
+	hrtimer_init(t, CLOCK_MONOTONIC, mode);
+	t->function = fn;
+#endif
+}
+
+/* === record ring === */
+static int ring_alloc(void)
+{
+	struct rec_ring *r = &g.ring;
+	unsigned int pages = roundup_pow_of_two(max(ring_pages, 1U));
+
+	r->mem = kzalloc(sizeof(*r->mem), GFP_KERNEL);
+	if (!r->mem)
+		return -ENOMEM;
+	r->size = PAGE_SIZE + (size_t)pages * PAGE_SIZE;
+	r->base = vmalloc_user(r->size);
+	if (!r->base) {
+		kfree(r->mem);
+		r->mem = NULL;
+		return -ENOMEM;
+	}
+	kref_init(&r->mem->ref);
+	r->mem->base = r->base;
+	atomic_set(&r->mem->busy, 0);
+
+	r->hdr  = r->base;
+	r->recs = r->base + PAGE_SIZE;
+	r->nrec = pages * (PAGE_SIZE / sizeof(struct rk_rec));
+	r->head = 0;
+
+	r->hdr->magic       = RK_RING_MAGIC;
+	r->hdr->version     = RK_RING_VERSION;
+	r->hdr->rec_size    = sizeof(struct rk_rec);
+	r->hdr->nrec        = r->nrec;
+	r->hdr->data_offset = PAGE_SIZE;
+	return 0;
+}
+
+static void ring_mem_release(struct kref *ref)
+{
+	struct ring_mem *m = container_of(ref, struct ring_mem, ref);
+
+	vfree(m->base);
+	kfree(m);
+}
+
+/* After misc_deregister(): no open can start, open files keep the memory */
+static void ring_free(void)
+{
+	struct rec_ring *r = &g.ring;
+
+	if (!r->mem)
+		return;
+	WRITE_ONCE(r->mem->gone, true);
+	wake_up_interruptible(&r->wq);
+	kref_put(&r->mem->ref, ring_mem_release);
+	r->mem = NULL;
+	r->base = NULL;
+	r->hdr = NULL;
+	r->recs = NULL;
+}
+
+/* Append one record. Caller holds g.lock (single producer).
+ * The consumer-owned tail is untrusted: a bogus value only makes the
+ * ring look full, it can never make us write outside recs[].
+ */
+static void ring_push(const struct rk_rec *rec)
+{
+	struct rec_ring *r = &g.ring;
+	u64 tail = smp_load_acquire(&r->hdr->tail);
+
+	if (r->head - tail >= r->nrec) {
+		WRITE_ONCE(r->hdr->dropped, r->hdr->dropped + 1);
+		return;
+	}
+	r->recs[r->head & (r->nrec - 1)] = *rec;
+	r->head++;
+	smp_store_release(&r->hdr->head, r->head);
+}
+
+/* misc_open() holds misc_mtx across this call and misc_deregister() takes
+ * it, so g.ring.mem cannot be freed under us here.
+ */
+static int ring_open(struct inode *inode, struct file *f)
+{
+	struct ring_mem *m = g.ring.mem;
+	unsigned long flags;
+
+	if (!m)
+		return -ENODEV;
+	if (atomic_cmpxchg(&m->busy, 0, 1))
+		return -EBUSY;
+	kref_get(&m->ref);
+	f->private_data = m;
+
+	/* A new consumer starts at the current head with a clean drop count */
+	spin_lock_irqsave(&g.lock, flags);
+	WRITE_ONCE(g.ring.hdr->tail, g.ring.head);
+	WRITE_ONCE(g.ring.hdr->dropped, 0);
+	spin_unlock_irqrestore(&g.lock, flags);
+	return 0;
+}
+
+static int ring_release(struct inode *inode, struct file *f)
+{
+	struct ring_mem *m = f->private_data;
+
+	atomic_set(&m->busy, 0);
+	kref_put(&m->ref, ring_mem_release);
+	return 0;
+}
+
+static int ring_mmap(struct file *f, struct vm_area_struct *vma)
+{
+	struct ring_mem *m = f->private_data;
+
+	if (READ_ONCE(m->gone))
+		return -ENODEV;
+	return remap_vmalloc_range(vma, m->base, vma->vm_pgoff);
+}
+
+static __poll_t ring_poll(struct file *f, poll_table *wait)
+{
+	struct ring_mem *m = f->private_data;
+	struct rk_ring_hdr *h = m->base;
+
+	poll_wait(f, &g.ring.wq, wait);
+	if (READ_ONCE(m->gone))
+		return EPOLLERR | EPOLLHUP;
+	if (READ_ONCE(h->tail) != smp_load_acquire(&h->head))
+		return EPOLLIN | EPOLLRDNORM;
+	return 0;
+}
+
+static const struct file_operations ring_fops = {
+	.owner   = THIS_MODULE,
+	.open    = ring_open,
+	.release = ring_release,
+	.mmap    = ring_mmap,
+	.poll    = ring_poll,
+	.llseek  = noop_llseek,
+};
+
+static struct miscdevice ring_misc = {
+	.minor = MISC_DYNAMIC_MINOR,
+	.name  = DRV_NAME,
+	.fops  = &ring_fops,
+	.mode  = 0600,
+};
+
+/* === generic netlink ===
+ * Family RK_GENL_NAME, multicast group RK_GENL_MCGRP; each message is
+ * RK_GENL_CMD_MEASURE with one RK_GENL_A_REC (struct rk_rec) per record.
+ * Records are queued under g.lock only while someone listens and sent from
+ * process context: by the IRQ thread once nl_batch are pending, otherwise
+ * by a delayed work after nl_flush_ms.
+ */
+static const struct genl_multicast_group rk_nl_mcgrps[] = {
+	{ .name = RK_GENL_MCGRP },
+};
+
+static struct genl_family rk_nl_family = {
+	.name     = RK_GENL_NAME,
+	.version  = RK_GENL_VERSION,
+	.maxattr  = RK_GENL_A_MAX,
+	.module   = THIS_MODULE,
+	.mcgrps   = rk_nl_mcgrps,
+	.n_mcgrps = ARRAY_SIZE(rk_nl_mcgrps),
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0)
+	.resv_start_op = RK_GENL_CMD_MEASURE + 1,
+#endif
+};
+
+static inline bool rk_nl_listening(void)
+{
+	return g.nl.registered && genl_has_listeners(&rk_nl_family, &init_net, 0);
+}
+
+/* Caller holds g.lock */
+static void rk_nl_queue(const struct rk_rec *rec)
+{
+	if (!rk_nl_listening())
+		return;
+	if (g.nl.n >= NL_BATCH_MAX) {
+		g.nl.dropped++;
+		return;
+	}
+	g.nl.q[g.nl.n++] = *rec;
+}
+
+static void rk_nl_flush(void)
+{
+	struct sk_buff *skb;
+	unsigned long flags;
+	unsigned int n;
+	void *hdr;
+
+	mutex_lock(&g.nl.mtx);
+	spin_lock_irqsave(&g.lock, flags);
+	n = g.nl.n;
+	memcpy(g.nl.out, g.nl.q, n * sizeof(g.nl.q[0]));
+	g.nl.n = 0;
+	spin_unlock_irqrestore(&g.lock, flags);
+	if (!n)
+		goto out;
+
+	skb = genlmsg_new(n * nla_total_size(sizeof(struct rk_rec)), GFP_KERNEL);
+	if (!skb)
+		goto out;
+	hdr = genlmsg_put(skb, 0, 0, &rk_nl_family, 0, RK_GENL_CMD_MEASURE);
+	if (!hdr) {
+		nlmsg_free(skb);
+		goto out;
+	}
+	for (unsigned int i = 0; i < n; i++) {
+		if (nla_put(skb, RK_GENL_A_REC, sizeof(struct rk_rec), &g.nl.out[i])) {
+			nlmsg_free(skb);
+			goto out;
+		}
+	}
+	genlmsg_end(skb, hdr);
+	/* -ESRCH just means the last listener left */
+	genlmsg_multicast(&rk_nl_family, skb, 0, 0, GFP_KERNEL);
+out:
+	mutex_unlock(&g.nl.mtx);
+}
+
+static void rk_nl_work(struct work_struct *w)
+{
+	rk_nl_flush();
+}
+
+/* After publishing, from the IRQ thread */
+static void rk_nl_kick(void)
+{
+	unsigned int n = READ_ONCE(g.nl.n);
+
+	if (!n)
+		return;
+	if (n >= nl_batch)
+		rk_nl_flush();
+	else
+		schedule_delayed_work(&g.nl.dwork, msecs_to_jiffies(nl_flush_ms));
+}
+
+/* === frames ===
+ * Every record lands in g.frame.cur; a frame is published (cur/pub swap)
+ * once every sensor reported, when the next trigger cycle starts, or at
+ * the end of its time window. Empty frames are not published. Readers
+ * copy g.frame.pub under g.lock, so they never see a torn frame.
+ */
+static void frame_reset(struct rk_frame *f, ktime_t start)
+{
+	f->mask = 0;
+	f->ts_ns = ktime_to_ns(start);
+	memset(f->s, 0, g.n * sizeof(f->s[0]));
+}
+
+/* Caller holds g.lock */
+static void frame_close(ktime_t now)
+{
+	struct rk_frame *f = g.frame.cur;
+
+	if (!f->mask)
+		return;
+	f->seq = ++g.frame.seq;
+	f->pub_ns = ktime_to_ns(now);
+	g.frame.cur = g.frame.pub;
+	g.frame.pub = f;
+	frame_reset(g.frame.cur, now);
+}
+
+/* Caller holds g.lock */
+static void frame_add(const struct rk_rec *rec)
+{
+	struct rk_frame *f = g.frame.cur;
+	struct rk_frame_sensor *o = &f->s[rec->sensor];
+
+	o->dist_um = rec->dist_um;
+	o->filt_um = rec->filt_um;
+	o->flags   = rec->flags;
+	f->mask |= BIT_ULL(rec->sensor);
+	if (!g.frame.window && f->mask == g.frame.all)
+		frame_close(ns_to_ktime(rec->ts_ns));
+}
+
+/* Trigger cycle boundary (first slot fires). Caller holds g.lock. */
+static void frame_cycle_start(ktime_t now)
+{
+	frame_close(now);
+	g.frame.cur->ts_ns = ktime_to_ns(now);
+}
+
+static void frame_wake(void)
+{
+	if (wq_has_sleeper(&g.frame.wq))
+		wake_up_interruptible(&g.frame.wq);
+}
+
+static enum hrtimer_restart frame_timer_fn(struct hrtimer *t)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&g.lock, flags);
+	frame_close(ktime_get());
+	spin_unlock_irqrestore(&g.lock, flags);
+	frame_wake();
+	hrtimer_forward_now(t, g.frame.period);
+	return HRTIMER_RESTART;
+}
+
+static int frame_alloc(struct device *dev)
+{
+	g.frame.size = struct_size(g.frame.cur, s, g.n);
+	g.frame.cur = devm_kzalloc(dev, g.frame.size, GFP_KERNEL);
+	g.frame.pub = devm_kzalloc(dev, g.frame.size, GFP_KERNEL);
+	if (!g.frame.cur || !g.frame.pub)
+		return -ENOMEM;
+	for (int k = 0; k < 2; k++) {
+		struct rk_frame *f = k ? g.frame.pub : g.frame.cur;
+
+		f->version     = RK_FRAME_VERSION;
+		f->hdr_size    = sizeof(struct rk_frame);
+		f->sensor_size = sizeof(struct rk_frame_sensor);
+		f->nsensors    = g.n;
+	}
+	g.frame.all = g.n == 64 ? ~0ULL : BIT_ULL(g.n) - 1;
+	g.frame.seq = 0;
+	frame_reset(g.frame.cur, ktime_get());
+	return 0;
+}
+
+/* Before the first trigger: cycles if we trigger, else time windows */
+static void frame_start(struct device *dev, bool triggered)
+{
+	g.frame.window = frame_window_us || !triggered;
+	if (!g.frame.window)
+		return;
+	g.frame.period = us_to_ktime(frame_window_us ?: 100000);
+	rk_hrtimer_setup(&g.frame.timer, frame_timer_fn, HRTIMER_MODE_REL_SOFT);
+	hrtimer_start(&g.frame.timer, g.frame.period, HRTIMER_MODE_REL_SOFT);
+	dev_info(dev, "frames: %lld us windows\n", ktime_to_us(g.frame.period));
+}
+
+static void frame_stop(void)
+{
+	if (g.frame.window)
+		hrtimer_cancel(&g.frame.timer);
+	g.frame.window = false;
+}
+
+/* Ring record + netlink queue + frame. Caller holds g.lock. */
+static void publish_rec(const struct rk_rec *rec)
+{
+	ring_push(rec);
+	rk_nl_queue(rec);
+	frame_add(rec);
+}
+
+/* === debugfs ===
+ * All files are poll()able: each open file remembers g.updates as of its
+ * last read from offset 0 and reports EPOLLIN once it moved on.
+ */
+struct snap_reader {
+	u32 seen;
+};
+
+static int snap_open(struct inode *inode, struct file *f)
+{
+	struct snap_reader *r = kzalloc(sizeof(*r), GFP_KERNEL);
+
+	if (!r)
+		return -ENOMEM;
+	r->seen = READ_ONCE(g.updates) - 1;  /* first poll() returns at once */
+	f->private_data = r;
+	return 0;
+}
+
+static int snap_release(struct inode *inode, struct file *f)
+{
+	kfree(f->private_data);
+	return 0;
+}
+
+static __poll_t snap_poll(struct file *f, poll_table *wait)
+{
+	struct snap_reader *r = f->private_data;
+
+	poll_wait(f, &g.snap_wq, wait);
+	if (READ_ONCE(g.updates) != r->seen)
+		return EPOLLIN | EPOLLRDNORM;
+	return 0;
+}
+
+static void snap_seen(struct file *f, loff_t *ppos, u32 updates)
+{
+	struct snap_reader *r = f->private_data;
+
+	if (*ppos == 0)
+		r->seen = updates;
+}
+
+/* "m.mmm,m.mmm,...\n", one value per sensor */
+static ssize_t dist_text_read(struct file *f, char __user *buf, size_t len, loff_t *ppos,
+                              bool filtered)
+{
+	size_t size = g.n * 16 + 2;
+	unsigned long flags;
+	u32 *um, updates;
+	char *tmp;
+	ssize_t ret;
+	int n = 0;
+
+	um = kmalloc_array(g.n, sizeof(*um), GFP_KERNEL);
+	tmp = kmalloc(size, GFP_KERNEL);
+	if (!um || !tmp) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	spin_lock_irqsave(&g.lock, flags);
+	for (int i = 0; i < g.n; i++)
+		um[i] = filtered ? g.s[i].filt_um : g.s[i].dist_um;
+	updates = g.updates;
+	spin_unlock_irqrestore(&g.lock, flags);
+	snap_seen(f, ppos, updates);
+
+	for (int i = 0; i < g.n; i++)
+		n += scnprintf(tmp + n, size - n, "%s%u.%03u", i ? "," : "",
+		               um[i] / 1000000U, (um[i] / 1000U) % 1000U);
+	n += scnprintf(tmp + n, size - n, "\n");
+	ret = simple_read_from_buffer(buf, len, ppos, tmp, n);
+out:
+	kfree(tmp);
+	kfree(um);
+	return ret;
+}
+
+static ssize_t distances_read(struct file *f, char __user *buf, size_t len, loff_t *ppos)
+{
+	return dist_text_read(f, buf, len, ppos, false);
+}
+
+static ssize_t filtered_read(struct file *f, char __user *buf, size_t len, loff_t *ppos)
+{
+	return dist_text_read(f, buf, len, ppos, true);
+}
+
+/* Per-sensor u32 counters printed by "stats", in output order */
+#define STAT(f) { #f, offsetof(struct sensor_state, f) }
+static const struct {
+	const char *name;
+	size_t off;
+} stat_fields[] = {
+	STAT(pulses), STAT(overruns), STAT(lost_rise), STAT(lost_fall),
+	STAT(resyncs), STAT(qdrops), STAT(timeouts), STAT(outliers), STAT(xtalk),
+	STAT(stops), STAT(storms),
+};
+#undef STAT
+
+/* "seq=N pulses=a,b,... overruns=..." on one line */
+static ssize_t stats_read(struct file *f, char __user *buf, size_t len, loff_t *ppos)
+{
+	const int nf = ARRAY_SIZE(stat_fields);
+	size_t size = 48 + nf * (16 + g.n * 11);
+	unsigned long flags;
+	u32 seq, updates, nl_dropped, *v;
+	char *tmp;
+	ssize_t ret;
+	int n;
+
+	v = kmalloc_array(nf * g.n, sizeof(*v), GFP_KERNEL);
+	tmp = kmalloc(size, GFP_KERNEL);
+	if (!v || !tmp) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	spin_lock_irqsave(&g.lock, flags);
+	seq = g.seq;
+	updates = g.updates;
+	nl_dropped = g.nl.dropped;
+	for (int k = 0; k < nf; k++)
+		for (int i = 0; i < g.n; i++)
+			v[k * g.n + i] = READ_ONCE(*(u32 *)((char *)&g.s[i] + stat_fields[k].off));
+	spin_unlock_irqrestore(&g.lock, flags);
+	snap_seen(f, ppos, updates);
+
+	n = scnprintf(tmp, size, "seq=%u nl_dropped=%u", seq, nl_dropped);
+	for (int k = 0; k < nf; k++) {
+		n += scnprintf(tmp + n, size - n, " %s=", stat_fields[k].name);
+		for (int i = 0; i < g.n; i++)
+			n += scnprintf(tmp + n, size - n, "%s%u", i ? "," : "", v[k * g.n + i]);
+	}
+	n += scnprintf(tmp + n, size - n, "\n");
+	ret = simple_read_from_buffer(buf, len, ppos, tmp, n);
+out:
+	kfree(tmp);
+	kfree(v);
+	return ret;
+}
+
+static ssize_t snapshot_read(struct file *f, char __user *buf, size_t len, loff_t *ppos)
+{
+	struct rk_snapshot *snap;
+	size_t size = struct_size(snap, s, g.n);
+	unsigned long flags;
+	ssize_t ret;
+
+	snap = kzalloc(size, GFP_KERNEL);
+	if (!snap)
+		return -ENOMEM;
+
+	snap->version     = RK_SNAPSHOT_VERSION;
+	snap->hdr_size    = sizeof(struct rk_snapshot);
+	snap->sensor_size = sizeof(struct rk_snapshot_sensor);
+	snap->nsensors    = g.n;
+
+	spin_lock_irqsave(&g.lock, flags);
+	snap->seq     = g.seq;
+	snap->updates = g.updates;
+	snap->ts_ns   = ktime_get_ns();
+	for (int i = 0; i < g.n; i++) {
+		const struct sensor_state *ss = &g.s[i];
+		struct rk_snapshot_sensor *o = &snap->s[i];
+
+		o->dist_um   = ss->dist_um;
+		o->pulses    = ss->pulses;
+		o->overruns  = ss->overruns;
+		o->lost_rise = ss->lost_rise;
+		o->lost_fall = ss->lost_fall;
+		o->resyncs   = ss->resyncs;
+		o->qdrops    = READ_ONCE(ss->qdrops);
+		o->ts_ns     = ktime_to_ns(ss->meas_ts);
+		o->timeouts  = ss->timeouts;
+		o->flags     = (ss->no_echo ? RK_SNAP_NO_ECHO : 0) |
+		               (ss->stopping ? RK_SNAP_STOP : 0) |
+		               (READ_ONCE(ss->faulty) ? RK_SNAP_FAULTY : 0);
+		o->filt_um   = ss->filt_um;
+		o->outliers  = ss->outliers;
+		o->xtalk     = ss->xtalk;
+		o->stops     = ss->stops;
+		o->storms    = READ_ONCE(ss->storms);
+	}
+	spin_unlock_irqrestore(&g.lock, flags);
+	snap_seen(f, ppos, snap->updates);
+
+	ret = simple_read_from_buffer(buf, len, ppos, snap, size);
+	kfree(snap);
+	return ret;
+}
+
+static const struct file_operations distances_fops = {
+	.owner   = THIS_MODULE,
+	.open    = snap_open,
+	.release = snap_release,
+	.read    = distances_read,
+	.poll    = snap_poll,
+	.llseek  = default_llseek,
+};
+static const struct file_operations filtered_fops = {
+	.owner   = THIS_MODULE,
+	.open    = snap_open,
+	.release = snap_release,
+	.read    = filtered_read,
+	.poll    = snap_poll,
+	.llseek  = default_llseek,
+};
+static const struct file_operations stats_fops = {
+	.owner   = THIS_MODULE,
+	.open    = snap_open,
+	.release = snap_release,
+	.read    = stats_read,
+	.poll    = snap_poll,
+	.llseek  = default_llseek,
+};
+static const struct file_operations snapshot_fops = {
+	.owner   = THIS_MODULE,
+	.open    = snap_open,
+	.release = snap_release,
+	.read    = snapshot_read,
+	.poll    = snap_poll,
+	.llseek  = default_llseek,
+};
+
+static int frame_open(struct inode *inode, struct file *f)
+{
+	struct snap_reader *r = kzalloc(sizeof(*r), GFP_KERNEL);
+
+	if (!r)
+		return -ENOMEM;
+	r->seen = READ_ONCE(g.frame.seq);  /* wait for the next frame */
+	f->private_data = r;
+	return 0;
+}
+
+static __poll_t frame_poll(struct file *f, poll_table *wait)
+{
+	struct snap_reader *r = f->private_data;
+
+	poll_wait(f, &g.frame.wq, wait);
+	if (READ_ONCE(g.frame.seq) != r->seen)
+		return EPOLLIN | EPOLLRDNORM;
+	return 0;
+}
+
+/* struct rk_frame + nsensors entries: the last published frame */
+static ssize_t frame_read(struct file *f, char __user *buf, size_t len, loff_t *ppos)
+{
+	struct snap_reader *r = f->private_data;
+	struct rk_frame *copy;
+	unsigned long flags;
+	ssize_t ret;
+
+	copy = kmalloc(g.frame.size, GFP_KERNEL);
+	if (!copy)
+		return -ENOMEM;
+	spin_lock_irqsave(&g.lock, flags);
+	memcpy(copy, g.frame.pub, g.frame.size);
+	spin_unlock_irqrestore(&g.lock, flags);
+	if (*ppos == 0)
+		r->seen = copy->seq;
+
+	ret = simple_read_from_buffer(buf, len, ppos, copy, g.frame.size);
+	kfree(copy);
+	return ret;
+}
+
+static const struct file_operations frame_fops = {
+	.owner   = THIS_MODULE,
+	.open    = frame_open,
+	.release = snap_release,
+	.read    = frame_read,
+	.poll    = frame_poll,
+	.llseek  = default_llseek,
+};
+
+/* === histograms ===
+ * Writers: this_cpu_inc() outside g.lock, no other synchronization (a
+ * single per-CPU op, safe against preemption and IRQs on PREEMPT_RT too).
+ * Reset never touches the counters: it snapshots the sums into hist_base
+ * under hist_mtx and readers subtract it, so nothing races with a writer.
+ */
+static inline int hist_bucket(s64 ns)
+{
+	return min(ns > 0 ? fls64(ns) - 1 : 0, HIST_BUCKETS - 1);
+}
+
+static inline void hist_add_width(int idx, s64 ns)
+{
+	this_cpu_inc(g.hist[idx].width[hist_bucket(ns)]);
+}
+
+static inline void hist_add_lat(int idx, s64 ns)
+{
+	this_cpu_inc(g.hist[idx].lat[hist_bucket(ns)]);
+}
+
+/* Raw sums over all CPUs (u32 wraps; sum - base stays exact) */
+static void hist_sum(int idx, struct sensor_hist *sum)
+{
+	int cpu;
+
+	memset(sum, 0, sizeof(*sum));
+	for_each_possible_cpu(cpu) {
+		const struct sensor_hist *h = per_cpu_ptr(&g.hist[idx], cpu);
+
+		for (int k = 0; k < HIST_BUCKETS; k++) {
+			sum->width[k] += READ_ONCE(h->width[k]);
+			sum->lat[k]   += READ_ONCE(h->lat[k]);
+		}
+	}
+}
+
+/* Upper bound (ns) of the bucket holding the q-th percentile */
+static u64 hist_pct(const u32 *h, u64 total, unsigned int q)
+{
+	u64 want = div_u64(total * q + 99, 100), acc = 0;
+
+	for (int k = 0; k < HIST_BUCKETS; k++) {
+		acc += h[k];
+		if (acc >= want)
+			return 2ULL << k;
+	}
+	return 0;
+}
+
+static void hist_show_row(struct seq_file *m, int idx, const char *kind, const u32 *h)
+{
+	u64 total = 0;
+
+	for (int k = 0; k < HIST_BUCKETS; k++)
+		total += h[k];
+	seq_printf(m, "%d %s %llu %llu %llu", idx, kind, total,
+	           total ? hist_pct(h, total, 50) : 0, total ? hist_pct(h, total, 99) : 0);
+	for (int k = 0; k < HIST_BUCKETS; k++)
+		seq_printf(m, " %u", h[k]);
+	seq_putc(m, '\n');
+}
+
+static int histograms_show(struct seq_file *m, void *v)
+{
+	struct sensor_hist sum;
+
+	seq_puts(m, "# sensor kind total p50_ns p99_ns b0..b31"
+	            " (bK counts values in [2^K, 2^(K+1)) ns; p*_ns are bucket upper bounds)\n");
+	mutex_lock(&g.hist_mtx);
+	for (int i = 0; i < g.n; i++) {
+		hist_sum(i, &sum);
+		for (int k = 0; k < HIST_BUCKETS; k++) {
+			sum.width[k] -= g.hist_base[i].width[k];
+			sum.lat[k]   -= g.hist_base[i].lat[k];
+		}
+		/* Placement the rows below were taken under (irq_cpus / irq_prio) */
+		seq_printf(m, "# sensor %d cpu=%d prio=%d tid=%d\n", i, g.s[i].cpu,
+		           READ_ONCE(g.s[i].prio_req), READ_ONCE(g.s[i].tid));
+		hist_show_row(m, i, "width", sum.width);
+		hist_show_row(m, i, "irq_lat", sum.lat);
+	}
+	mutex_unlock(&g.hist_mtx);
+	return 0;
+}
+
+static int histograms_open(struct inode *inode, struct file *f)
+{
+	return single_open_size(f, histograms_show, NULL,
+	                        g.n * (2 * (HIST_BUCKETS + 5) * 12 + 64) + 256);
+}
+
+/* Any write resets all histograms */
+static ssize_t histograms_write(struct file *f, const char __user *buf, size_t len, loff_t *ppos)
+{
+	mutex_lock(&g.hist_mtx);
+	for (int i = 0; i < g.n; i++)
+		hist_sum(i, &g.hist_base[i]);
+	mutex_unlock(&g.hist_mtx);
+	return len;
+}
+
+static const struct file_operations histograms_fops = {
+	.owner   = THIS_MODULE,
+	.open    = histograms_open,
+	.read    = seq_read,
+	.write   = histograms_write,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+/* === IIO (RANGER_K_IIO=y) ===
+ * in_distanceN_raw is micrometers, scale 0.000001 -> meters (IIO unit).
+ * The "ranger_k-measure" trigger fires from the IRQ thread after every
+ * completed measurement; the pollfunc pushes a full scan and the IIO core
+ * demuxes it down to the enabled channels (single available scan mask).
+ */
+#ifdef RANGER_K_IIO
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 4, 0)
+#define iio_trigger_poll_nested iio_trigger_poll_chained
+#endif
+
+static int rk_iio_read_raw(struct iio_dev *indio, struct iio_chan_spec const *chan,
+                           int *val, int *val2, long mask)
+{
+	unsigned long flags;
+
+	switch (mask) {
+	case IIO_CHAN_INFO_RAW:
+		spin_lock_irqsave(&g.lock, flags);
+		*val = g.s[chan->channel].dist_um;
+		spin_unlock_irqrestore(&g.lock, flags);
+		return IIO_VAL_INT;
+	case IIO_CHAN_INFO_SCALE:
+		*val = 0;
+		*val2 = 1;  /* um -> m */
+		return IIO_VAL_INT_PLUS_MICRO;
+	case IIO_CHAN_INFO_OFFSET:
+		*val = 0;
+		return IIO_VAL_INT;
+	}
+	return -EINVAL;
+}
+
+static const struct iio_info rk_iio_info = {
+	.read_raw = rk_iio_read_raw,
+};
+
+static irqreturn_t rk_iio_trigger_handler(int irq, void *p)
+{
+	struct iio_poll_func *pf = p;
+	struct iio_dev *indio = pf->indio_dev;
+	unsigned long flags;
+
+	spin_lock_irqsave(&g.lock, flags);
+	for (int i = 0; i < g.n; i++)
+		g.iio.scan[i] = g.s[i].dist_um;
+	spin_unlock_irqrestore(&g.lock, flags);
+
+	iio_push_to_buffers_with_timestamp(indio, g.iio.scan, iio_get_time_ns(indio));
+	iio_trigger_notify_done(indio->trig);
+	return IRQ_HANDLED;
+}
+
+/* Called from the IRQ thread (threaded context, no locks held) */
+static void rk_iio_measured(void)
+{
+	if (g.iio.trig)
+		iio_trigger_poll_nested(g.iio.trig);
+}
+
+static void rk_iio_unregister(void)
+{
+	if (!g.iio.indio)
+		return;
+	iio_device_unregister(g.iio.indio);
+	iio_triggered_buffer_cleanup(g.iio.indio);
+	iio_trigger_unregister(g.iio.trig);
+	iio_trigger_put(g.iio.indio->trig);
+	iio_trigger_free(g.iio.trig);
+	iio_device_free(g.iio.indio);
+	kfree(g.iio.chans);
+	bitmap_free(g.iio.scan_masks);
+	kfree(g.iio.scan);
+	memset(&g.iio, 0, sizeof(g.iio));
+}
+
+static int rk_iio_register(struct device *parent)
+{
+	int nch = g.n + 1;  /* + timestamp */
+	struct iio_dev *indio;
+	struct iio_trigger *trig;
+	int ret;
+
+	g.iio.chans = kcalloc(nch, sizeof(*g.iio.chans), GFP_KERNEL);
+	/* scan masks: one full mask + zero terminator */
+	g.iio.scan_masks = bitmap_zalloc(2 * BITS_TO_LONGS(nch) * BITS_PER_LONG, GFP_KERNEL);
+	g.iio.scan = kzalloc(ALIGN(g.n * sizeof(u32), sizeof(s64)) + sizeof(s64), GFP_KERNEL);
+	if (!g.iio.chans || !g.iio.scan_masks || !g.iio.scan) {
+		ret = -ENOMEM;
+		goto err_free;
+	}
+
+	for (int i = 0; i < g.n; i++) {
+		struct iio_chan_spec *c = &g.iio.chans[i];
+
+		c->type = IIO_DISTANCE;
+		c->indexed = 1;
+		c->channel = i;
+		c->info_mask_separate = BIT(IIO_CHAN_INFO_RAW);
+		c->info_mask_shared_by_type = BIT(IIO_CHAN_INFO_SCALE) | BIT(IIO_CHAN_INFO_OFFSET);
+		c->scan_index = i;
+		c->scan_type.sign = 'u';
+		c->scan_type.realbits = 32;
+		c->scan_type.storagebits = 32;
+		c->scan_type.endianness = IIO_CPU;
+		set_bit(i, g.iio.scan_masks);
+	}
+	g.iio.chans[g.n] = (struct iio_chan_spec)IIO_CHAN_SOFT_TIMESTAMP(g.n);
+
+	indio = iio_device_alloc(parent, 0);
+	if (!indio) {
+		ret = -ENOMEM;
+		goto err_free;
+	}
+	indio->name = DRV_NAME;
+	indio->info = &rk_iio_info;
+	indio->modes = INDIO_DIRECT_MODE;
+	indio->channels = g.iio.chans;
+	indio->num_channels = nch;
+	indio->available_scan_masks = g.iio.scan_masks;
+
+	trig = iio_trigger_alloc(parent, "%s-measure", DRV_NAME);
+	if (!trig) {
+		ret = -ENOMEM;
+		goto err_dev;
+	}
+	ret = iio_trigger_register(trig);
+	if (ret)
+		goto err_trig;
+	indio->trig = iio_trigger_get(trig);
+
+	ret = iio_triggered_buffer_setup(indio, NULL, rk_iio_trigger_handler, NULL);
+	if (ret)
+		goto err_trig_reg;
+
+	ret = iio_device_register(indio);
+	if (ret)
+		goto err_buf;
+
+	g.iio.indio = indio;
+	g.iio.trig = trig;
+	pr_info(DRV_NAME ": IIO device registered (%d distance channels, trigger %s-measure)\n",
+	        g.n, DRV_NAME);
+	return 0;
+
+err_buf:
+	iio_triggered_buffer_cleanup(indio);
+err_trig_reg:
+	iio_trigger_put(indio->trig);
+	iio_trigger_unregister(trig);
+err_trig:
+	iio_trigger_free(trig);
+err_dev:
+	iio_device_free(indio);
+err_free:
+	kfree(g.iio.chans);
+	bitmap_free(g.iio.scan_masks);
+	kfree(g.iio.scan);
+	memset(&g.iio, 0, sizeof(g.iio));
+	return ret;
+}
+#else
+static inline void rk_iio_measured(void) {}
+static inline void rk_iio_unregister(void) {}
+static inline int rk_iio_register(struct device *parent) { return 0; }
+#endif
+
+/* === IRQ handlers ===
+ * The hard handler only timestamps the edge and, when the chip allows it,
+ * samples the line level. Hard-IRQ latency is a few microseconds, far
+ * below the shortest echo (~150 us), so that sample is reliable; the
+ * thread-wakeup latency is not, which is why the thread never decides
+ * the edge direction from a level it reads itself.
+ */
+/* Per-line edge rate limit, counted in STORM_WINDOW_MS windows. Runs in
+ * the line's hard handler (its thread for nested chips), so the window
+ * needs no lock. Returns true when the line was just shut off.
+ */
+static bool sensor_storm_check(int idx, struct sensor_state *s, ktime_t now)
+{
+	unsigned int limit = max(storm_rate * STORM_WINDOW_MS / 1000, 1U);
+
+	if (!storm_rate || READ_ONCE(g.storm_off))
+		return false;
+	if (ktime_after(now, s->storm_end)) {
+		s->storm_end = ktime_add_ms(now, STORM_WINDOW_MS);
+		s->storm_edges = 0;
+	}
+	if (++s->storm_edges <= limit)
+		return false;
+
+	disable_irq_nosync(s->irq);
+	WRITE_ONCE(s->faulty, true);
+	WRITE_ONCE(s->storms, s->storms + 1);
+	schedule_delayed_work(&s->storm_work, msecs_to_jiffies(storm_backoff_ms));
+	trace_ranger_k_storm(idx, ktime_to_ns(now), s->storm_edges);
+	return true;
+}
+
+/* Back-off over: forget the half-seen pulse, resync the level, re-arm */
+static void storm_work_fn(struct work_struct *w)
+{
+	struct sensor_state *s = container_of(to_delayed_work(w), struct sensor_state, storm_work);
+	int level = gpiod_get_value_cansleep(s->gdesc);
+	unsigned long flags;
+
+	spin_lock_irqsave(&g.lock, flags);
+	s->have_rise = false;
+	s->late_fall = false;
+	if (level >= 0)
+		s->level = level;
+	s->storm_end = 0;
+	WRITE_ONCE(s->faulty, false);
+	spin_unlock_irqrestore(&g.lock, flags);
+	enable_irq(s->irq);
+}
+
+static irqreturn_t echo_irq_hard(int irq, void *dev_id)
+{
+	int idx = (long)dev_id;
+	struct sensor_state *s = &g.s[idx];
+	unsigned int head = s->fifo_head;
+	ktime_t now = ktime_get();
+	struct edge_evt *e;
+
+	if (sensor_storm_check(idx, s, now))
+		return IRQ_HANDLED;
+	if (head - smp_load_acquire(&s->fifo_tail) >= EDGE_FIFO) {
+		WRITE_ONCE(s->qdrops, s->qdrops + 1);
+		return IRQ_WAKE_THREAD;
+	}
+	e = &s->fifo[head & (EDGE_FIFO - 1)];
+	e->ts = now;
+	e->level = s->hw_level ? gpiod_get_value(s->gdesc) : -1;
+	smp_store_release(&s->fifo_head, head + 1);
+
+	return IRQ_WAKE_THREAD;
+}
+
+/* Echo timed out: drop the pending rise, flag the sensor and publish a
+ * RK_REC_NO_ECHO record. Caller holds g.lock.
+ */
+static void sensor_no_echo(int idx, struct sensor_state *s, ktime_t ts)
+{
+	struct rk_rec rec = {
+		.ts_ns    = ktime_to_ns(ts),
+		.seq      = g.seq,
+		.sensor   = idx,
+		.flags    = RK_REC_NO_ECHO,
+		.width_ns = echo_timeout_us[idx] * NSEC_PER_USEC,
+	};
 
-/* Module parameters:
- * Either provide all five legacy GPIO numbers or leave entries as -1
- * to auto-detect the gpio-sim base and use base..base+4 (typically 768..772).
+	s->have_rise = false;
+	s->no_echo = true;
+	s->timeouts++;
+	g.updates++;
+	publish_rec(&rec);
+	trace_ranger_k_timeout(idx, ktime_to_ns(ts), s->level);
+}
+
+/* Runs in softirq context, so it may race with the IRQ thread: only act
+ * if the rise it was armed for is still pending and no edge is queued
+ * (a queued falling edge is judged by the thread against the same limit).
  */
-static int line_gpios[MAX_SENSORS] = { -1, -1, -1, -1, -1 };
-module_param_array(line_gpios, int, NULL, 0444);
-MODULE_PARM_DESC(line_gpios, "Legacy GPIO numbers for ECHO lines (5 items)");
+static enum hrtimer_restart echo_timeout_fn(struct hrtimer *t)
+{
+	struct sensor_state *s = container_of(t, struct sensor_state, echo_timer);
+	int idx = s - g.s;
+	ktime_t now = ktime_get();
+	unsigned long flags;
+	bool fired = false;
 
-struct sensor_state {
-	bool have_rise;
-	ktime_t rise_ts;
-	u32 dist_um;   /* last measured distance (micrometers) */
-	u32 pulses;    /* successfully measured pulses */
-	u32 overruns;  /* falling edge without a prior rising edge */
-	int irq;
-	struct gpio_desc *gdesc;
-};
+	spin_lock_irqsave(&g.lock, flags);
+	if (s->have_rise && s->fifo_tail == smp_load_acquire(&s->fifo_head) &&
+	    ktime_after(now, ktime_add_us(s->rise_ts, echo_timeout_us[idx]))) {
+		sensor_no_echo(idx, s, now);
+		s->late_fall = true;
+		fired = true;
+	}
+	spin_unlock_irqrestore(&g.lock, flags);
 
-static struct {
-	struct dentry *dbg_dir;
-	spinlock_t lock; /* protects s[] and seq */
-	struct sensor_state s[MAX_SENSORS];
-	u32 seq;
-} g;
+	if (fired) {
+		if (wq_has_sleeper(&g.ring.wq))
+			wake_up_interruptible(&g.ring.wq);
+		if (wq_has_sleeper(&g.snap_wq))
+			wake_up_interruptible(&g.snap_wq);
+		frame_wake();
+		if (READ_ONCE(g.nl.n))  /* softirq: leave sending to the work */
+			schedule_delayed_work(&g.nl.dwork, 0);
+	}
+	return HRTIMER_NORESTART;
+}
 
-/* ns -> um: distance_um = t * 171500 / 1e6
- * (speed of sound ≈ 343 m/s, divide by 2 for round trip)
- */
-static inline u32 width_ns_to_um(s64 width_ns)
+/* Stop/clear hysteresis on the filtered distance. Caller holds g.lock. */
+static void sensor_stop_check(int idx, struct sensor_state *s)
 {
-	return (u32)div64_u64((u64)width_ns * 171500ULL, 1000000ULL);
+	u32 stop = stop_mm[idx] * 1000U;
+
+	if (!stop)
+		return;
+	if (!s->stopping && s->filt_um < stop) {
+		s->stopping = true;
+		s->stops++;
+		g.estop.dirty |= g.estop.active++ == 0;
+	} else if (s->stopping && s->filt_um > stop + stop_hyst_mm * 1000U) {
+		s->stopping = false;
+		g.estop.dirty |= --g.estop.active == 0;
+	} else {
+		return;
+	}
+	trace_ranger_k_estop(idx, s->filt_um, s->stopping, g.estop.active);
 }
 
-/* === debugfs === */
-static ssize_t distances_read(struct file *f, char __user *buf, size_t len, loff_t *ppos)
+/* Drive the e-stop line to match g.estop.active. IRQ thread context. */
+static void estop_apply(void)
 {
-	char tmp[256];
 	unsigned long flags;
-	u32 um[MAX_SENSORS];
-	int n;
+	bool want;
 
+	mutex_lock(&g.estop.mtx);
 	spin_lock_irqsave(&g.lock, flags);
-	for (int i = 0; i < MAX_SENSORS; i++)
-		um[i] = g.s[i].dist_um;
+	want = g.estop.active > 0;
+	g.estop.dirty = false;
 	spin_unlock_irqrestore(&g.lock, flags);
+	if (want != g.estop.out) {
+		gpiod_set_value_cansleep(g.estop.desc, want);
+		g.estop.out = want;
+	}
+	mutex_unlock(&g.estop.mtx);
+}
+
+/* Classify and account one edge. Caller holds g.lock.
+ * Returns true when a record was published. A completed pulse also sets
+ * *width (left alone otherwise) for the histogram, which the caller
+ * records after dropping g.lock.
+ */
+static bool sensor_edge(int idx, struct sensor_state *s, ktime_t ts, int level, s64 *width)
+{
+	int expect = !s->level;
+	int sampled = level;
+
+	if (level >= 0 && level != expect) {
+		/* Same level twice in a row: the opposite edge was lost */
+		if (level)
+			s->lost_fall++;
+		else
+			s->lost_rise++;
+	}
+	if (level < 0)
+		level = expect;
+	s->level = level;
+
+	if (level) {
+		/* Rising edge */
+		trace_ranger_k_rise(idx, ktime_to_ns(ts), sampled);
+		if (g.trig.desc) {
+			/* Only an echo of our own, already fired trigger counts */
+			if (!s->trig_armed || ktime_before(ts, s->trig_ts)) {
+				s->xtalk++;
+				s->have_rise = false;
+				s->late_fall = true;
+				return false;
+			}
+			s->trig_armed = false;
+			s->trig_ns = (u32)min_t(s64, ktime_to_ns(ktime_sub(ts, s->trig_ts)), U32_MAX);
+		}
+		s->have_rise = true;
+		s->rise_ts = ts;
+		s->late_fall = false;
+		if (echo_timeout_us[idx])
+			hrtimer_start(&s->echo_timer, ktime_add_us(ts, echo_timeout_us[idx]),
+			              HRTIMER_MODE_ABS_SOFT);
+		return false;
+	}
+	trace_ranger_k_fall(idx, ktime_to_ns(ts), sampled);
+
+	/* Falling edge */
+	if (s->have_rise) {
+		s64 dt = ktime_to_ns(ktime_sub(ts, s->rise_ts));
+		struct rk_rec rec;
+
+		hrtimer_try_to_cancel(&s->echo_timer);
+		if (echo_timeout_us[idx] && dt > (s64)echo_timeout_us[idx] * NSEC_PER_USEC) {
+			/* Never publish a width longer than the sensor can produce */
+			sensor_no_echo(idx, s, ts);
+			return true;
+		}
+
+		s->have_rise = false;
+		s->no_echo = false;
+		s->pulses++;
+		s->dist_um = width_ns_to_um(dt);
+		sensor_filter(s, s->dist_um);
+		sensor_stop_check(idx, s);
+		s->meas_ts = ts;
+		g.updates++;
+		*width = dt;
 
-#define M_INT(u)   ((u) / 1000000U)
-#define M_FRAC3(u) (((u) / 1000U) % 1000U)
-	n = scnprintf(tmp, sizeof(tmp),
-	              "%u.%03u,%u.%03u,%u.%03u,%u.%03u,%u.%03u\n",
-	              M_INT(um[0]), M_FRAC3(um[0]),
-	              M_INT(um[1]), M_FRAC3(um[1]),
-	              M_INT(um[2]), M_FRAC3(um[2]),
-	              M_INT(um[3]), M_FRAC3(um[3]),
-	              M_INT(um[4]), M_FRAC3(um[4]));
-#undef M_INT
-#undef M_FRAC3
-	return simple_read_from_buffer(buf, len, ppos, tmp, n);
+		rec = (struct rk_rec){
+			.ts_ns    = ktime_to_ns(ts),
+			.seq      = g.seq + 1,
+			.sensor   = idx,
+			.flags    = s->stopping ? RK_REC_STOP : 0,
+			.width_ns = (u32)min_t(s64, dt, U32_MAX),
+			.dist_um  = s->dist_um,
+			.filt_um  = s->filt_um,
+			.trig_ns  = g.trig.desc ? s->trig_ns : 0,
+		};
+		publish_rec(&rec);
+		trace_ranger_k_measure(idx, rec.width_ns, rec.dist_um, rec.filt_um, rec.seq);
+		return true;
+	}
+	if (s->late_fall) {
+		/* End of a pulse already reported as no-echo */
+		s->late_fall = false;
+		return false;
+	}
+	s->overruns++;
+	trace_ranger_k_overrun(idx, ktime_to_ns(ts), sampled);
+	return false;
 }
 
-static ssize_t stats_read(struct file *f, char __user *buf, size_t len, loff_t *ppos)
+/* Sleeping chips give no hard-IRQ level sample, so a lost edge would
+ * invert the toggle forever. Once the queue is idle, compare the tracked
+ * level with the line and resync if they still disagree after a short
+ * settle delay (an edge in flight would have queued by then).
+ */
+static void sensor_verify_level(struct sensor_state *s)
 {
-	char tmp[256];
+	unsigned int head = smp_load_acquire(&s->fifo_head);
 	unsigned long flags;
-	u32 seq, pulses[MAX_SENSORS], overr[MAX_SENSORS];
-	int n;
+	int level;
+
+	if (head != s->fifo_tail)
+		return;
+	level = gpiod_get_value_cansleep(s->gdesc);
+	if (level < 0 || level == READ_ONCE(s->level))
+		return;
+
+	usleep_range(20, 50);
+	if (smp_load_acquire(&s->fifo_head) != head ||
+	    gpiod_get_value_cansleep(s->gdesc) != level)
+		return;
 
 	spin_lock_irqsave(&g.lock, flags);
-	seq = g.seq;
-	for (int i = 0; i < MAX_SENSORS; i++) {
-		pulses[i] = g.s[i].pulses;
-		overr[i]  = g.s[i].overruns;
+	if (s->fifo_tail == head) {
+		s->level = level;
+		s->have_rise = false;  /* a rise we did not time cannot be measured */
+		s->resyncs++;
 	}
 	spin_unlock_irqrestore(&g.lock, flags);
+}
 
-	n = scnprintf(tmp, sizeof(tmp),
-	              "seq=%u pulses=%u,%u,%u,%u,%u overruns=%u,%u,%u,%u,%u\n",
-	              seq, pulses[0], pulses[1], pulses[2], pulses[3], pulses[4],
-	              overr[0], overr[1], overr[2], overr[3], overr[4]);
+/* A thread can only be reprioritized or pinned from outside through its
+ * task, which the IRQ core does not hand out, so the thread applies the
+ * requested settings to itself on its next run.
+ */
+static void sensor_apply_sched(struct device *dev, struct sensor_state *s)
+{
+	int pin = READ_ONCE(s->pin_req), prio = READ_ONCE(s->prio_req);
 
-	return simple_read_from_buffer(buf, len, ppos, tmp, n);
-}
+	if (pin != s->pin_cur) {
+		if (set_cpus_allowed_ptr(current, pin < 0 ? cpu_possible_mask : cpumask_of(pin)))
+			dev_warn_once(dev, "cannot pin irq %d thread to CPU %d\n", s->irq, pin);
+		s->pin_cur = pin;
+	}
+	if (prio != s->prio_cur) {
+		struct sched_attr attr = {
+			.size = sizeof(attr),
+			.sched_policy = prio < 0 ? SCHED_NORMAL : SCHED_FIFO,
+			.sched_priority = prio < 0 ? 0 : prio ? prio : MAX_RT_PRIO / 2,
+		};
 
-static const struct file_operations distances_fops = {
-	.owner = THIS_MODULE,
-	.read  = distances_read,
-	.llseek = default_llseek,
-};
-static const struct file_operations stats_fops = {
-	.owner = THIS_MODULE,
-	.read  = stats_read,
-	.llseek = default_llseek,
-};
+		if (sched_setattr_nocheck(current, &attr))
+			dev_warn_once(dev, "cannot set irq %d thread priority %d\n", s->irq, prio);
+		s->prio_cur = prio;
+	}
+	s->tid = task_pid_nr(current);
+}
 
-/* === threaded IRQ handler ===
- * Use a threaded-only handler (primary=NULL) so we can call *_cansleep()
- * and avoid touching the interrupt controller fast path.
- */
 static irqreturn_t echo_irq_thread(int irq, void *dev_id)
 {
 	int idx = (long)dev_id;
 	struct sensor_state *s = &g.s[idx];
-	ktime_t now = ktime_get();
-	int level = gpiod_get_value_cansleep(s->gdesc);
+	unsigned int tail = s->fifo_tail, head;
+	ktime_t woke = ktime_get();
+	s64 widths[EDGE_FIFO + 1];
 	unsigned long flags;
+	bool published = false;
+	int nw = 0;
+
+	if (unlikely(!s->tid || READ_ONCE(s->pin_req) != s->pin_cur ||
+	             READ_ONCE(s->prio_req) != s->prio_cur))
+		sensor_apply_sched(&g.pdev->dev, s);
+
+	if (s->nested && sensor_storm_check(idx, s, woke))
+		return IRQ_HANDLED;
+
+	/* Drain up to a snapshot of the FIFO head; edges queued after it come
+	 * with their own wakeup (the hard IRQ always wakes the thread). Every
+	 * snapshot edge is stamped before now, so latencies are never negative.
+	 */
+	head = smp_load_acquire(&s->fifo_head);
+	if (tail != head) {
+		woke = ktime_get();
+		for (unsigned int t = tail; t != head; t++)
+			hist_add_lat(idx, ktime_to_ns(ktime_sub(woke, s->fifo[t & (EDGE_FIFO - 1)].ts)));
+	}
 
 	spin_lock_irqsave(&g.lock, flags);
-	if (level) {
-		/* Rising edge */
-		s->have_rise = true;
-		s->rise_ts = now;
-	} else {
-		/* Falling edge */
-		if (s->have_rise) {
-			s64 dt = ktime_to_ns(ktime_sub(now, s->rise_ts));
-			s->have_rise = false;
-			s->pulses++;
-			s->dist_um = width_ns_to_um(dt);
-		} else {
-			s->overruns++;
-		}
+	if (s->nested) {
+		/* No hard stage: one wakeup per edge, timestamp here */
+		widths[nw] = -1;
+		published |= sensor_edge(idx, s, woke, -1, &widths[nw]);
+		if (widths[nw] >= 0)
+			nw++;
+		g.seq++;
+	}
+	while (tail != head) {
+		const struct edge_evt *e = &s->fifo[tail & (EDGE_FIFO - 1)];
+
+		widths[nw] = -1;
+		published |= sensor_edge(idx, s, e->ts, e->level, &widths[nw]);
+		if (widths[nw] >= 0)
+			nw++;
+		g.seq++;
+		smp_store_release(&s->fifo_tail, ++tail);
 	}
-	g.seq++;
 	spin_unlock_irqrestore(&g.lock, flags);
 
+	for (int k = 0; k < nw; k++)
+		hist_add_width(idx, widths[k]);
+
+	/* Safety output first, before any reader is woken */
+	if (g.estop.desc && READ_ONCE(g.estop.dirty))
+		estop_apply();
+
+	if (!s->hw_level)
+		sensor_verify_level(s);
+
+	/* Only pay for a wakeup when someone is actually sleeping */
+	if (published) {
+		if (wq_has_sleeper(&g.ring.wq))
+			wake_up_interruptible(&g.ring.wq);
+		if (wq_has_sleeper(&g.snap_wq))
+			wake_up_interruptible(&g.snap_wq);
+		frame_wake();
+		rk_nl_kick();
+		rk_iio_measured();
+	}
+
 	return IRQ_HANDLED;
 }
 
-/* Auto-scan a gpio-sim chip: label == "gpio-sim.0-node0" → base */
-static int autoscan_gpio_sim_base(int *base_out, int *ngpio_out)
+/* === trigger scheduler ===
+ * Slot k fires every sensor i with i % nslots == k (nslots: 1 = sim,
+ * n = rr, trig_groups = groups). Each step either raises the slot's lines
+ * and arms their echo pairing, or drops them and moves to the next slot;
+ * slot starts are absolute so the cadence does not drift.
+ */
+
+/* Echo pairing and frame cycle for a slot whose lines just went high.
+ * Takes g.lock (a sleeping lock on PREEMPT_RT) and wakes readers, so the
+ * hard trigger timer defers it to arm_work.
+ */
+static void trig_arm(unsigned int slot, ktime_t now)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&g.lock, flags);
+	if (slot == 0 && !g.frame.window)
+		frame_cycle_start(now);
+	for (int i = slot; i < g.n; i += g.trig.nslots) {
+		g.s[i].trig_armed = true;
+		g.s[i].trig_ts = now;
+	}
+	spin_unlock_irqrestore(&g.lock, flags);
+	if (slot == 0)
+		frame_wake();
+}
+
+static void trig_arm_work(struct irq_work *work)
+{
+	struct trig_sched *t = container_of(work, struct trig_sched, arm_work);
+
+	trig_arm(READ_ONCE(t->arm_slot), t->arm_ts);
+}
+
+/* Drive one step on the TRIG lines; no locks, safe in hard IRQ context.
+ * Returns true after raising a slot: arm_slot/arm_ts then need trig_arm().
+ */
+static bool trig_step(void)
+{
+	struct trig_sched *t = &g.trig;
+	unsigned long *vals;
+	ktime_t now;
+
+	if (!t->high) {
+		bitmap_zero(t->on, g.n);
+		for (int i = t->slot; i < g.n; i += t->nslots)
+			__set_bit(i, t->on);
+		vals = t->on;
+	} else {
+		vals = t->off;
+	}
+
+	if (t->cansleep)
+		gpiod_set_array_value_cansleep(g.n, t->desc, t->info, vals);
+	else
+		gpiod_set_array_value(g.n, t->desc, t->info, vals);
+	now = ktime_get();
+
+	if (!t->high) {
+		t->arm_ts = now;
+		WRITE_ONCE(t->arm_slot, t->slot);
+		t->high = true;
+		t->next = ktime_add_us(now, trig_pulse_us);
+		return true;
+	}
+
+	t->high = false;
+	t->slot = t->slot + 1 < t->nslots ? t->slot + 1 : 0;
+	t->slot_ts = ktime_add_us(t->slot_ts, trig_period_us);
+	if (ktime_before(t->slot_ts, now))  /* overran a whole slot: realign */
+		t->slot_ts = now;
+	t->next = t->slot_ts;
+	return false;
+}
+
+/* Hard timer: only the GPIO edge is timing-critical. Arming runs right after
+ * from irq_work (IRQ exit, or its kthread on PREEMPT_RT), long before an echo
+ * can rise (>= ~150 us after the trigger on an HC-SR04).
+ */
+static enum hrtimer_restart trig_timer_fn(struct hrtimer *timer)
+{
+	if (trig_step())
+		irq_work_queue(&g.trig.arm_work);
+	hrtimer_set_expires(timer, g.trig.next);
+	return HRTIMER_RESTART;
+}
+
+/* Sleeping chips: same steps from an RT kthread, paced by hrtimer sleeps */
+static int trig_thread(void *arg)
+{
+	sched_set_fifo(current);
+	while (!kthread_should_stop()) {
+		ktime_t next = g.trig.next;
+
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (kthread_should_stop()) {
+			__set_current_state(TASK_RUNNING);
+			break;
+		}
+		schedule_hrtimeout_range(&next, 0, HRTIMER_MODE_ABS);
+		if (!kthread_should_stop() && trig_step())
+			trig_arm(g.trig.arm_slot, g.trig.arm_ts);
+	}
+	return 0;
+}
+
+static int trig_start(struct device *dev)
+{
+	struct trig_sched *t = &g.trig;
+
+	if (!strcmp(trig_mode, "sim"))
+		t->nslots = 1;
+	else if (!strcmp(trig_mode, "rr"))
+		t->nslots = g.n;
+	else if (!strcmp(trig_mode, "groups"))
+		t->nslots = clamp_t(unsigned int, trig_groups, 1, g.n);
+	else {
+		dev_err(dev, "unknown trig_mode '%s'\n", trig_mode);
+		return -EINVAL;
+	}
+	bitmap_zero(t->off, MAX_SENSORS);
+	t->cansleep = gpiod_cansleep(t->desc[0]);
+	t->slot = 0;
+	t->high = false;
+	t->slot_ts = ktime_add_us(ktime_get(), trig_period_us);
+	t->next = t->slot_ts;
+
+	if (t->cansleep) {
+		t->task = kthread_run(trig_thread, NULL, DRV_NAME "-trig");
+		if (IS_ERR(t->task)) {
+			int ret = PTR_ERR(t->task);
+
+			t->task = NULL;
+			return ret;
+		}
+	} else {
+		init_irq_work(&t->arm_work, trig_arm_work);
+		rk_hrtimer_setup(&t->timer, trig_timer_fn, HRTIMER_MODE_ABS_HARD);
+		hrtimer_start(&t->timer, t->next, HRTIMER_MODE_ABS_HARD);
+	}
+	dev_info(dev, "TRIG %s: %u slot(s) of %u us, %u us pulses%s\n", trig_mode,
+	         t->nslots, trig_period_us, trig_pulse_us,
+	         t->cansleep ? " (sleeping chip: kthread)" : "");
+	return 0;
+}
+
+static void trig_stop(void)
 {
-	struct file *f;
-	char path[128], lbl[64];
-	int base, ngpio;
+	struct trig_sched *t = &g.trig;
 
-	*base_out = -1;
-	*ngpio_out = 0;
+	if (!t->desc)
+		return;
+	if (t->task)
+		kthread_stop(t->task);
+	else if (t->nslots) {
+		hrtimer_cancel(&t->timer);
+		irq_work_sync(&t->arm_work);
+	}
+	t->task = NULL;
+	t->nslots = 0;
+	gpiod_set_array_value_cansleep(g.n, t->desc, t->info, t->off);
+	t->desc = NULL;
+}
+
+/* === IRQ placement ===
+ * irq_cpus / irq_prio (module parameters, and the same-named sysfs files of
+ * the bound device) place each sensor's echo IRQ and IRQ thread. The hard
+ * IRQ follows irq_set_affinity() where the irqchip supports it, and the
+ * IRQ core moves the thread along; otherwise only the thread is pinned.
+ */
+static void sensor_set_cpu(struct device *dev, struct sensor_state *s, int cpu)
+{
+	int ret = irq_set_affinity(s->irq, cpu < 0 ? cpu_possible_mask : cpumask_of(cpu));
 
-	for (int chip = 0; chip < 4; chip++) {
-		snprintf(path, sizeof(path), "/sys/class/gpio/gpiochip%d/label", 512 + chip*256);
-		f = filp_open(path, O_RDONLY, 0);
-		if (IS_ERR(f))
-			continue;
+	if (ret)
+		dev_dbg(dev, "irq %d: no affinity control (%d), pinning the thread only\n",
+		        s->irq, ret);
+	s->cpu = cpu;
+	WRITE_ONCE(s->pin_req, ret ? cpu : -1);
+}
 
-		memset(lbl, 0, sizeof(lbl));
-		kernel_read(f, lbl, sizeof(lbl)-1, &f->f_pos);
-		filp_close(f, NULL);
+/* "a,b,c" -> v[], at most one value per sensor, each in lo..hi */
+static int rk_parse_list(const char *buf, int *v, int lo, int hi)
+{
+	char *copy = kstrdup(buf, GFP_KERNEL), *p, *tok;
+	int n = 0, ret = 0;
 
-		/* Read base */
-		snprintf(path, sizeof(path), "/sys/class/gpio/gpiochip%d/base", 512 + chip*256);
-		f = filp_open(path, O_RDONLY, 0);
-		if (IS_ERR(f))
-			continue;
-		{
-			char tmp[16]={0};
-			kernel_read(f, tmp, sizeof(tmp)-1, &f->f_pos);
-			base = simple_strtol(tmp, NULL, 10);
+	if (!copy)
+		return -ENOMEM;
+	p = strim(copy);
+	while ((tok = strsep(&p, ","))) {
+		if (n == g.n || kstrtoint(tok, 0, &v[n]) || v[n] < lo || v[n] > hi) {
+			ret = -EINVAL;
+			break;
 		}
-		filp_close(f, NULL);
-
-		/* Read ngpio */
-		snprintf(path, sizeof(path), "/sys/class/gpio/gpiochip%d/ngpio", 512 + chip*256);
-		f = filp_open(path, O_RDONLY, 0);
-		if (IS_ERR(f))
-			continue;
-		{
-			char tmp[16]={0};
-			kernel_read(f, tmp, sizeof(tmp)-1, &f->f_pos);
-			ngpio = simple_strtol(tmp, NULL, 10);
+		n++;
+	}
+	kfree(copy);
+	return ret ? ret : n;
+}
+
+static ssize_t irq_cpus_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	int len = 0;
+
+	for (int i = 0; i < g.n; i++)
+		len += sysfs_emit_at(buf, len, "%s%d", i ? "," : "", g.s[i].cpu);
+	return len + sysfs_emit_at(buf, len, "\n");
+}
+
+static ssize_t irq_cpus_store(struct device *dev, struct device_attribute *attr,
+                              const char *buf, size_t count)
+{
+	int v[MAX_SENSORS], n = rk_parse_list(buf, v, -1, nr_cpu_ids - 1);
+
+	if (n < 0)
+		return n;
+	for (int i = 0; i < n; i++)
+		if (v[i] >= 0 && !cpu_online(v[i]))
+			return -EINVAL;
+	for (int i = 0; i < n; i++)
+		sensor_set_cpu(dev, &g.s[i], v[i]);
+	return count;
+}
+static DEVICE_ATTR_RW(irq_cpus);
+
+static ssize_t irq_prio_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	int len = 0;
+
+	for (int i = 0; i < g.n; i++)
+		len += sysfs_emit_at(buf, len, "%s%d", i ? "," : "", READ_ONCE(g.s[i].prio_req));
+	return len + sysfs_emit_at(buf, len, "\n");
+}
+
+static ssize_t irq_prio_store(struct device *dev, struct device_attribute *attr,
+                              const char *buf, size_t count)
+{
+	int v[MAX_SENSORS], n = rk_parse_list(buf, v, -1, MAX_RT_PRIO - 1);
+
+	if (n < 0)
+		return n;
+	for (int i = 0; i < n; i++)
+		WRITE_ONCE(g.s[i].prio_req, v[i]);
+	return count;
+}
+static DEVICE_ATTR_RW(irq_prio);
+
+/* Thread ids for chrt/taskset/ps; 0 until the line's first interrupt */
+static ssize_t irq_tids_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	int len = 0;
+
+	for (int i = 0; i < g.n; i++)
+		len += sysfs_emit_at(buf, len, "%s%d", i ? "," : "", READ_ONCE(g.s[i].tid));
+	return len + sysfs_emit_at(buf, len, "\n");
+}
+static DEVICE_ATTR_RO(irq_tids);
+
+static struct attribute *ranger_k_attrs[] = {
+	&dev_attr_irq_cpus.attr,
+	&dev_attr_irq_prio.attr,
+	&dev_attr_irq_tids.attr,
+	NULL
+};
+ATTRIBUTE_GROUPS(ranger_k);
+
+/* === probe ===
+ * Echo lines: legacy numbers (line_gpios=) on the module's own device,
+ * otherwise the device's "echo" GPIO array (DT echo-gpios, or the lookup
+ * table registered below for sim_chip).
+ */
+
+/* The module's own device: no fwnode, no instance id. Not g.own, which is
+ * only set once platform_device_register_simple() (and its probe) returned.
+ */
+static bool ranger_k_own_dev(struct device *dev)
+{
+	return !dev_fwnode(dev) && to_platform_device(dev)->id == PLATFORM_DEVID_NONE;
+}
+
+static int ranger_k_get_lines(struct device *dev, struct gpio_desc ***descs)
+{
+	struct gpio_descs *arr;
+	struct gpio_desc **d;
+	int ret;
+
+	if (n_line_gpios && ranger_k_own_dev(dev)) {
+		d = devm_kcalloc(dev, n_line_gpios, sizeof(*d), GFP_KERNEL);
+		if (!d)
+			return -ENOMEM;
+		for (int i = 0; i < n_line_gpios; i++) {
+			ret = devm_gpio_request_one(dev, line_gpios[i], GPIOF_IN, DRV_NAME);
+			if (ret) {
+				dev_err(dev, "gpio_request_one(%d) failed: %d\n", line_gpios[i], ret);
+				return ret;
+			}
+			d[i] = gpio_to_desc(line_gpios[i]);
 		}
-		filp_close(f, NULL);
+		*descs = d;
+		return n_line_gpios;
+	}
+
+	arr = devm_gpiod_get_array(dev, "echo", GPIOD_IN);
+	if (IS_ERR(arr))
+		return dev_err_probe(dev, PTR_ERR(arr), "no echo GPIOs\n");
+	if (arr->ndescs > MAX_SENSORS) {
+		dev_err(dev, "%u echo GPIOs, at most %d supported\n", arr->ndescs, MAX_SENSORS);
+		return -EINVAL;
+	}
+	*descs = arr->desc;
+	return arr->ndescs;
+}
+
+static void ranger_k_free_irqs(void)
+{
+	WRITE_ONCE(g.storm_off, true);
+	for (int i = 0; i < g.n; i++) {
+		struct sensor_state *s = &g.s[i];
 
-		if (strnstr(lbl, "gpio-sim.0-node0", sizeof(lbl))) {
-			*base_out  = base;   /* typically 768 */
-			*ngpio_out = ngpio;  /* typically 8   */
-			return 0;
+		if (s->irq > 0) {
+			/* No handler can shut the line off past this point */
+			synchronize_irq(s->irq);
+			cancel_delayed_work_sync(&s->storm_work);
+			if (s->faulty)
+				enable_irq(s->irq);
+			free_irq(s->irq, (void *)(long)i);
+			s->irq = 0;
 		}
+		hrtimer_cancel(&s->echo_timer);
 	}
-	return -ENODEV;
 }
 
-static int __init ranger_k_init(void)
+static void ranger_k_teardown(void)
+{
+	frame_stop();
+	trig_stop();
+	ranger_k_free_irqs();
+	g.estop.desc = NULL;
+	g.estop.active = 0;
+	g.estop.dirty = false;
+	g.estop.out = false;
+	rk_iio_unregister();
+	if (g.nl.registered) {
+		g.nl.registered = false;
+		cancel_delayed_work_sync(&g.nl.dwork);
+		genl_unregister_family(&rk_nl_family);
+		g.nl.n = 0;
+	}
+	debugfs_remove_recursive(g.dbg_dir);
+	g.dbg_dir = NULL;
+	misc_deregister(&ring_misc);
+	ring_free();
+	free_percpu(g.hist);
+	g.hist = NULL;
+	g.n = 0;
+	g.s = NULL;  /* devm-allocated */
+	g.pdev = NULL;
+}
+
+static int ranger_k_probe(struct platform_device *pdev)
 {
-	int ret = 0, base = -1, ngpio = 0;
+	struct device *dev = &pdev->dev;
+	struct gpio_descs *trig;
+	struct gpio_desc **descs;
+	int n, ret;
 
-	spin_lock_init(&g.lock);
+	/* One instance: g is module-wide */
+	if (g.pdev)
+		return -EBUSY;
+
+	n = ranger_k_get_lines(dev, &descs);
+	if (n < 0)
+		return n;
+	if (!n)
+		return -ENODEV;
 
-	/* If no params are provided, try auto 768..772 via gpio-sim scan */
-	bool need_auto = true;
-	for (int i = 0; i < MAX_SENSORS; i++)
-		if (line_gpios[i] >= 0) { need_auto = false; break; }
+	g.s = devm_kcalloc(dev, n, sizeof(*g.s), GFP_KERNEL);
+	if (!g.s)
+		return -ENOMEM;
+	for (int i = 0; i < n; i++) {
+		g.s[i].gdesc = descs[i];
+		rk_hrtimer_setup(&g.s[i].echo_timer, echo_timeout_fn, HRTIMER_MODE_ABS_SOFT);
+		INIT_DELAYED_WORK(&g.s[i].storm_work, storm_work_fn);
+	}
+	g.n = n;
+	g.pdev = pdev;
+	g.storm_off = false;
+
+	ret = frame_alloc(dev);
+	if (ret)
+		goto fail;
+
+	trig = devm_gpiod_get_array_optional(dev, "trig", GPIOD_OUT_LOW);
+	if (IS_ERR(trig)) {
+		ret = dev_err_probe(dev, PTR_ERR(trig), "bad trig GPIOs\n");
+		goto fail;
+	}
+	if (trig && trig->ndescs != n) {
+		dev_err(dev, "%u trig GPIOs for %d sensors\n", trig->ndescs, n);
+		ret = -EINVAL;
+		goto fail;
+	}
+
+	g.estop.desc = devm_gpiod_get_optional(dev, "estop", GPIOD_OUT_LOW);
+	if (IS_ERR(g.estop.desc)) {
+		ret = dev_err_probe(dev, PTR_ERR(g.estop.desc), "bad estop GPIO\n");
+		g.estop.desc = NULL;
+		goto fail;
+	}
 
-	if (need_auto && !autoscan_gpio_sim_base(&base, &ngpio)) {
-		if (ngpio < MAX_SENSORS)
-			pr_warn(DRV_NAME ": gpio-sim has only %d lines, will still use first %d\n",
-			        ngpio, MAX_SENSORS);
-		for (int i = 0; i < MAX_SENSORS; i++)
-			line_gpios[i] = base + i;
+	g.hist_base = devm_kcalloc(dev, n, sizeof(*g.hist_base), GFP_KERNEL);
+	g.hist = __alloc_percpu(n * sizeof(struct sensor_hist), __alignof__(struct sensor_hist));
+	if (!g.hist || !g.hist_base) {
+		free_percpu(g.hist);
+		g.hist = NULL;
+		ret = -ENOMEM;
+		goto fail;
+	}
+
+	/* mmap record ring: /dev/ranger_k */
+	ret = ring_alloc();
+	if (ret) {
+		free_percpu(g.hist);
+		g.hist = NULL;
+		goto fail;
+	}
+	ring_misc.parent = dev;
+	ret = misc_register(&ring_misc);
+	if (ret) {
+		dev_err(dev, "misc_register failed: %d\n", ret);
+		ring_free();
+		free_percpu(g.hist);
+		g.hist = NULL;
+		goto fail;
 	}
 
 	/* debugfs */
 	g.dbg_dir = debugfs_create_dir(DRV_NAME, NULL);
-	if (!g.dbg_dir)
-		return -ENOMEM;
 	debugfs_create_file("distances", 0444, g.dbg_dir, NULL, &distances_fops);
+	debugfs_create_file("filtered",  0444, g.dbg_dir, NULL, &filtered_fops);
 	debugfs_create_file("stats",      0444, g.dbg_dir, NULL, &stats_fops);
+	debugfs_create_file("snapshot",   0444, g.dbg_dir, NULL, &snapshot_fops);
+	debugfs_create_file("histograms", 0644, g.dbg_dir, NULL, &histograms_fops);
+	debugfs_create_file("frame",      0444, g.dbg_dir, NULL, &frame_fops);
 
-	pr_info(DRV_NAME ": params line_gpios={%d,%d,%d,%d,%d}\n",
-	        line_gpios[0], line_gpios[1], line_gpios[2], line_gpios[3], line_gpios[4]);
-
-	/* Per-line initialization */
-	for (int i = 0; i < MAX_SENSORS; i++) {
-		int gpio = line_gpios[i];
-		if (gpio < 0)
-			continue;
+	ret = genl_register_family(&rk_nl_family);
+	if (ret) {
+		dev_err(dev, "genl_register_family failed: %d\n", ret);
+		goto fail_teardown;
+	}
+	g.nl.registered = true;
 
-		/* 1) Explicitly request the line as input */
-		ret = gpio_request_one(gpio, GPIOF_IN, DRV_NAME);
-		if (ret) {
-			pr_err(DRV_NAME ": gpio_request_one(%d) failed: %d\n", gpio, ret);
-			goto fail;
-		}
+	ret = rk_iio_register(dev);
+	if (ret) {
+		dev_err(dev, "IIO registration failed: %d\n", ret);
+		goto fail_teardown;
+	}
 
-		/* 2) Get descriptor and IRQ */
-		g.s[i].gdesc = gpio_to_desc(gpio);
-		if (!g.s[i].gdesc) {
-			pr_err(DRV_NAME ": gpio_to_desc(%d) failed\n", gpio);
-			ret = -EINVAL;
-			goto fail;
-		}
+	/* Per-line initialization */
+	for (int i = 0; i < n; i++) {
+		struct sensor_state *s = &g.s[i];
 
-		/* Legacy API note: direction is already input; enforce for safety */
-		ret = gpiod_direction_input(g.s[i].gdesc);
-		if (ret) {
-			pr_err(DRV_NAME ": gpiod_direction_input(%d) failed\n", gpio);
-			goto fail;
+		s->irq = gpiod_to_irq(s->gdesc);
+		if (s->irq < 0) {
+			dev_err(dev, "gpiod_to_irq(line %d) failed: %d\n", i, s->irq);
+			ret = s->irq;
+			s->irq = 0;
+			goto fail_teardown;
 		}
 
-		g.s[i].irq = gpiod_to_irq(g.s[i].gdesc);
-		if (g.s[i].irq < 0) {
-			pr_err(DRV_NAME ": gpiod_to_irq(%d) failed: %d\n", gpio, g.s[i].irq);
-			ret = g.s[i].irq;
-			goto fail;
-		}
+		/* Edge tracking starts from the current line level */
+		s->hw_level = !gpiod_cansleep(s->gdesc);
+		s->nested   = irq_check_status_bit(s->irq, IRQ_NESTED_THREAD);
+		s->level    = gpiod_get_value_cansleep(s->gdesc) > 0;
+		s->cpu      = -1;
+		s->pin_req  = s->pin_cur = -1;
+		if (irq_prio[i] >= -1 && irq_prio[i] < MAX_RT_PRIO)
+			s->prio_req = irq_prio[i];
+		else
+			dev_warn(dev, "irq_prio[%d]=%d out of range, ignored\n", i, irq_prio[i]);
 
-		/* 3) Threaded IRQ on both edges */
-		ret = request_threaded_irq(g.s[i].irq,
-		                           /*primary*/NULL,
+		/* Hard + threaded IRQ on both edges. No IRQF_ONESHOT: the line
+		 * must stay unmasked while the thread runs or edges are lost.
+		 */
+		ret = request_threaded_irq(s->irq,
+		                           /*primary*/echo_irq_hard,
 		                           /*thread */echo_irq_thread,
-		                           IRQF_ONESHOT |
 		                           IRQF_TRIGGER_RISING |
 		                           IRQF_TRIGGER_FALLING,
 		                           DRV_NAME,
 		                           (void *)(long)i);
 		if (ret) {
-			pr_err(DRV_NAME ": request_threaded_irq(GPIO%d->irq %d) failed: %d\n",
-			       gpio, g.s[i].irq, ret);
-			goto fail;
+			dev_err(dev, "request_threaded_irq(line %d -> irq %d) failed: %d\n",
+			        i, s->irq, ret);
+			s->irq = 0;
+			goto fail_teardown;
 		}
 
-		pr_info(DRV_NAME ": line[%d]=GPIO%d -> irq %d OK\n", i, gpio, g.s[i].irq);
+		if (irq_cpus[i] >= 0 && irq_cpus[i] < nr_cpu_ids && cpu_online(irq_cpus[i]))
+			sensor_set_cpu(dev, s, irq_cpus[i]);
+		else if (irq_cpus[i] >= 0)
+			dev_warn(dev, "irq_cpus[%d]=%d: CPU not online, ignored\n", i, irq_cpus[i]);
+
+		dev_dbg(dev, "line[%d]=GPIO%d -> irq %d%s%s\n", i, desc_to_gpio(s->gdesc), s->irq,
+		        s->hw_level ? "" : " (sleeping chip: toggle + idle resync)",
+		        s->nested ? " (nested irq)" : "");
 	}
 
-	pr_info(DRV_NAME ": loaded (threaded IRQ MVP)\n");
+	frame_start(dev, trig);
+
+	/* Triggers last: every echo IRQ is in place before the first ping */
+	if (trig) {
+		g.trig.desc = trig->desc;
+		g.trig.info = trig->info;
+		ret = trig_start(dev);
+		if (ret) {
+			g.trig.desc = NULL;
+			goto fail_teardown;
+		}
+	}
+
+	dev_info(dev, "%d sensors, ring %u records on /dev/" DRV_NAME "%s%s\n",
+	         n, g.ring.nrec, g.s[0].hw_level ? "" : ", sleeping chip (toggle + idle resync)",
+	         g.s[0].nested ? ", nested irq" : "");
 	return 0;
 
+fail_teardown:
+	ranger_k_teardown();
+	return ret;
 fail:
-	for (int i = 0; i < MAX_SENSORS; i++) {
-		if (g.s[i].irq > 0) {
-			free_irq(g.s[i].irq, (void *)(long)i);
-			g.s[i].irq = 0;
-		}
-		if (line_gpios[i] >= 0)
-			gpio_free(line_gpios[i]);
+	g.n = 0;
+	g.s = NULL;
+	g.pdev = NULL;
+	return ret;
+}
+
+static void ranger_k_remove(struct platform_device *pdev)
+{
+	if (g.pdev == pdev)
+		ranger_k_teardown();
+}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 11, 0)
+static int ranger_k_remove_compat(struct platform_device *pdev)
+{
+	ranger_k_remove(pdev);
+	return 0;
+}
+#define RK_REMOVE ranger_k_remove_compat
+#else
+#define RK_REMOVE ranger_k_remove
+#endif
+
+static const struct of_device_id ranger_k_of_match[] = {
+	{ .compatible = "omnirevolve,ranger-k" },
+	{ }
+};
+MODULE_DEVICE_TABLE(of, ranger_k_of_match);
+
+static struct platform_driver ranger_k_driver = {
+	.probe  = ranger_k_probe,
+	.remove = RK_REMOVE,
+	.driver = {
+		.name = DRV_NAME,
+		.of_match_table = ranger_k_of_match,
+		.dev_groups = ranger_k_groups,
+	},
+};
+
+/* Map lines 0..sim_lines-1 of sim_chip to our device's "echo" array */
+static int ranger_k_add_lookup(void)
+{
+	unsigned int n = n_line_gpios ? n_line_gpios : sim_lines;
+	bool echo = !n_line_gpios, trig = sim_trig_chip && *sim_trig_chip;
+	bool estop = sim_estop_chip && *sim_estop_chip;
+	unsigned int k = 0;
+
+	if (!echo && !trig && !estop)
+		return 0;
+	if (n < 1 || n > MAX_SENSORS) {
+		pr_err(DRV_NAME ": sim_lines=%u out of range 1..%d\n", n, MAX_SENSORS);
+		return -EINVAL;
 	}
-	debugfs_remove_recursive(g.dbg_dir);
+	g.lookup = kzalloc(struct_size(g.lookup, table, 2 * n + 2), GFP_KERNEL);
+	if (!g.lookup)
+		return -ENOMEM;
+	g.lookup->dev_id = DRV_NAME;
+	for (unsigned int i = 0; echo && i < n; i++)
+		g.lookup->table[k++] = (struct gpiod_lookup)
+			GPIO_LOOKUP_IDX(sim_chip, i, "echo", i, GPIO_ACTIVE_HIGH);
+	for (unsigned int i = 0; trig && i < n; i++)
+		g.lookup->table[k++] = (struct gpiod_lookup)
+			GPIO_LOOKUP_IDX(sim_trig_chip, sim_trig_offset + i, "trig", i, GPIO_ACTIVE_HIGH);
+	if (estop)
+		g.lookup->table[k++] = (struct gpiod_lookup)
+			GPIO_LOOKUP_IDX(sim_estop_chip, sim_estop_line, "estop", 0, GPIO_ACTIVE_HIGH);
+	gpiod_add_lookup_table(g.lookup);
+	return 0;
+}
+
+static int __init ranger_k_init(void)
+{
+	int ret;
+
+	filter_window = clamp(filter_window | 1, 1U, (unsigned int)FILT_MAX);
+
+	spin_lock_init(&g.lock);
+	init_waitqueue_head(&g.snap_wq);
+	init_waitqueue_head(&g.frame.wq);
+	init_waitqueue_head(&g.ring.wq);
+	mutex_init(&g.estop.mtx);
+	mutex_init(&g.nl.mtx);
+	mutex_init(&g.hist_mtx);
+	INIT_DELAYED_WORK(&g.nl.dwork, rk_nl_work);
+	nl_batch = clamp(nl_batch, 1U, (unsigned int)NL_BATCH_MAX);
+
+	ret = platform_driver_register(&ranger_k_driver);
+	if (ret)
+		return ret;
+
+	/* Own device for gpio-sim / legacy numbers; DT-only setups use sim_chip="" */
+	if (!n_line_gpios && (!sim_chip || !*sim_chip))
+		return 0;
+	ret = ranger_k_add_lookup();
+	if (ret)
+		goto fail_drv;
+	/* Probes now, or later (deferred) once sim_chip shows up */
+	g.own = platform_device_register_simple(DRV_NAME, PLATFORM_DEVID_NONE, NULL, 0);
+	if (IS_ERR(g.own)) {
+		ret = PTR_ERR(g.own);
+		g.own = NULL;
+		goto fail_lookup;
+	}
+	if (!g.pdev)
+		pr_info(DRV_NAME ": waiting for %s (%u lines)\n",
+		        n_line_gpios ? "line_gpios" : sim_chip,
+		        n_line_gpios ? n_line_gpios : sim_lines);
+	return 0;
+
+fail_lookup:
+	if (g.lookup) {
+		gpiod_remove_lookup_table(g.lookup);
+		kfree(g.lookup);
+	}
+fail_drv:
+	platform_driver_unregister(&ranger_k_driver);
 	return ret;
 }
 
 static void __exit ranger_k_exit(void)
 {
-	for (int i = 0; i < MAX_SENSORS; i++) {
-		if (g.s[i].irq > 0)
-			free_irq(g.s[i].irq, (void *)(long)i);
-		if (line_gpios[i] >= 0)
-			gpio_free(line_gpios[i]);
+	platform_device_unregister(g.own);
+	platform_driver_unregister(&ranger_k_driver);
+	if (g.lookup) {
+		gpiod_remove_lookup_table(g.lookup);
+		kfree(g.lookup);
 	}
-	debugfs_remove_recursive(g.dbg_dir);
 	pr_info(DRV_NAME ": unloaded\n");
 }
 
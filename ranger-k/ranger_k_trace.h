@@ -0,0 +1,120 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ranger_k tracepoints
+ *
+ * Edge events carry the hard-IRQ timestamp (CLOCK_MONOTONIC) while the
+ * trace record itself is stamped when the IRQ thread handles the edge, so
+ * with `trace-cmd record -C mono` the difference is the IRQ->thread
+ * latency for that edge. Disabled tracepoints cost a patched-out branch.
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM ranger_k
+
+#if !defined(_RANGER_K_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _RANGER_K_TRACE_H
+
+#include <linux/tracepoint.h>
+
+DECLARE_EVENT_CLASS(ranger_k_edge,
+	TP_PROTO(unsigned int sensor, s64 ts_ns, int level),
+	TP_ARGS(sensor, ts_ns, level),
+	TP_STRUCT__entry(
+		__field(unsigned int, sensor)
+		__field(s64, ts_ns)
+		__field(int, level)
+	),
+	TP_fast_assign(
+		__entry->sensor = sensor;
+		__entry->ts_ns  = ts_ns;
+		__entry->level  = level;
+	),
+	TP_printk("sensor=%u ts_ns=%lld level=%d",
+		  __entry->sensor, __entry->ts_ns, __entry->level)
+);
+
+/* level: hard-IRQ sample, or -1 when the chip can sleep */
+DEFINE_EVENT(ranger_k_edge, ranger_k_rise,
+	TP_PROTO(unsigned int sensor, s64 ts_ns, int level),
+	TP_ARGS(sensor, ts_ns, level));
+
+DEFINE_EVENT(ranger_k_edge, ranger_k_fall,
+	TP_PROTO(unsigned int sensor, s64 ts_ns, int level),
+	TP_ARGS(sensor, ts_ns, level));
+
+/* Falling edge without a timed rising edge */
+DEFINE_EVENT(ranger_k_edge, ranger_k_overrun,
+	TP_PROTO(unsigned int sensor, s64 ts_ns, int level),
+	TP_ARGS(sensor, ts_ns, level));
+
+/* No falling edge within echo_timeout_us (ts_ns = detection time) */
+DEFINE_EVENT(ranger_k_edge, ranger_k_timeout,
+	TP_PROTO(unsigned int sensor, s64 ts_ns, int level),
+	TP_ARGS(sensor, ts_ns, level));
+
+TRACE_EVENT(ranger_k_measure,
+	TP_PROTO(unsigned int sensor, u32 width_ns, u32 dist_um, u32 filt_um, u32 seq),
+	TP_ARGS(sensor, width_ns, dist_um, filt_um, seq),
+	TP_STRUCT__entry(
+		__field(unsigned int, sensor)
+		__field(u32, width_ns)
+		__field(u32, dist_um)
+		__field(u32, filt_um)
+		__field(u32, seq)
+	),
+	TP_fast_assign(
+		__entry->sensor   = sensor;
+		__entry->width_ns = width_ns;
+		__entry->dist_um  = dist_um;
+		__entry->filt_um  = filt_um;
+		__entry->seq      = seq;
+	),
+	TP_printk("sensor=%u width_ns=%u dist_um=%u filt_um=%u seq=%u",
+		  __entry->sensor, __entry->width_ns, __entry->dist_um,
+		  __entry->filt_um, __entry->seq)
+);
+
+/* Edge storm: line shut off for storm_backoff_ms */
+TRACE_EVENT(ranger_k_storm,
+	TP_PROTO(unsigned int sensor, s64 ts_ns, unsigned int edges),
+	TP_ARGS(sensor, ts_ns, edges),
+	TP_STRUCT__entry(
+		__field(unsigned int, sensor)
+		__field(s64, ts_ns)
+		__field(unsigned int, edges)
+	),
+	TP_fast_assign(
+		__entry->sensor = sensor;
+		__entry->ts_ns  = ts_ns;
+		__entry->edges  = edges;
+	),
+	TP_printk("sensor=%u ts_ns=%lld edges=%u", __entry->sensor, __entry->ts_ns, __entry->edges)
+);
+
+/* Stop threshold crossed; active = sensors currently stopping */
+TRACE_EVENT(ranger_k_estop,
+	TP_PROTO(unsigned int sensor, u32 filt_um, bool stop, int active),
+	TP_ARGS(sensor, filt_um, stop, active),
+	TP_STRUCT__entry(
+		__field(unsigned int, sensor)
+		__field(u32, filt_um)
+		__field(bool, stop)
+		__field(int, active)
+	),
+	TP_fast_assign(
+		__entry->sensor  = sensor;
+		__entry->filt_um = filt_um;
+		__entry->stop    = stop;
+		__entry->active  = active;
+	),
+	TP_printk("sensor=%u filt_um=%u %s active=%d", __entry->sensor, __entry->filt_um,
+		  __entry->stop ? "STOP" : "clear", __entry->active)
+);
+
+#endif /* _RANGER_K_TRACE_H */
+
+/* This part must be outside the include guard */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE ranger_k_trace
+#include <trace/define_trace.h>
@@ -0,0 +1,164 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * ranger_k userspace ABI
+ *
+ * Shared between the module and userspace readers (ranger-u, ranger-k-test).
+ * Only fixed-width __u* types; every struct has an explicit layout.
+ */
+#ifndef RANGER_K_UAPI_H
+#define RANGER_K_UAPI_H
+
+#include <linux/types.h>
+
+/* Most sensors one module instance drives (rk_frame.mask has a bit each) */
+#define RK_MAX_SENSORS 64
+
+/* === mmap ring: /dev/ranger_k ===
+ * Mapping layout:
+ *   [0, data_offset)                  struct rk_ring_hdr (one page)
+ *   [data_offset, +nrec * rec_size)   struct rk_rec[nrec]
+ *
+ * The module is the only producer and publishes `head` with release
+ * semantics after the record is written. The (single) consumer reads
+ * records in [tail, head), then stores the new `tail` with release
+ * semantics. Indices are free-running; slot = index & (nrec - 1).
+ * When head - tail == nrec the ring is full and new records are dropped
+ * (counted in `dropped`). poll() reports EPOLLIN while head != tail.
+ */
+#define RK_RING_MAGIC   0x524b5247u  /* "RKRG" */
+#define RK_RING_VERSION 1
+
+struct rk_ring_hdr {
+	__u32 magic;
+	__u32 version;
+	__u32 rec_size;     /* sizeof(struct rk_rec) */
+	__u32 nrec;         /* capacity, power of two */
+	__u32 data_offset;  /* byte offset of record 0 */
+	__u32 reserved0;
+	__u64 dropped;      /* records lost because the ring was full */
+	__u64 reserved1[4];
+	/* producer-owned (own cache line) */
+	__u64 head;
+	__u64 pad_head[7];
+	/* consumer-owned (own cache line) */
+	__u64 tail;
+	__u64 pad_tail[7];
+};
+
+/* rk_rec.flags */
+#define RK_REC_NO_ECHO  0x0001  /* no falling edge within the echo timeout; dist_um = 0 */
+#define RK_REC_STOP     0x0002  /* sensor is inside its stop distance */
+
+/* One completed measurement (falling edge), or an echo timeout. */
+struct rk_rec {
+	__u64 ts_ns;     /* falling-edge timestamp, CLOCK_MONOTONIC */
+	__u32 seq;       /* module-wide sequence at publish time */
+	__u16 sensor;    /* sensor index */
+	__u16 flags;     /* RK_REC_* */
+	__u32 width_ns;  /* echo pulse width */
+	__u32 dist_um;   /* raw distance (micrometers) */
+	__u32 filt_um;   /* median-filtered distance (micrometers) */
+	__u32 trig_ns;   /* own trigger -> echo rise; 0 without TRIG lines */
+};
+
+/* === binary snapshot: /sys/kernel/debug/ranger_k/snapshot ===
+ * One read() returns struct rk_snapshot followed by nsensors entries of
+ * struct rk_snapshot_sensor (use hdr_size/sensor_size to step, newer
+ * versions only append fields). poll() on this file (and on the text
+ * files) reports EPOLLIN once a new measurement was published since the
+ * caller's last read from offset 0; re-read with pread(fd, ..., 0).
+ */
+#define RK_SNAPSHOT_VERSION 6
+
+/* rk_snapshot_sensor.flags */
+#define RK_SNAP_NO_ECHO 0x0001  /* last cycle timed out; dist_um is the previous echo */
+#define RK_SNAP_STOP    0x0002  /* inside the stop distance (e-stop asserted) */
+#define RK_SNAP_FAULTY  0x0004  /* line shut off after an edge storm (back-off running) */
+
+struct rk_snapshot_sensor {
+	__u32 dist_um;    /* last raw distance (micrometers) */
+	__u32 pulses;
+	__u32 overruns;
+	__u32 lost_rise;
+	__u32 lost_fall;
+	__u32 resyncs;
+	__u32 qdrops;
+	__u32 flags;      /* RK_SNAP_* */
+	__u64 ts_ns;      /* last measurement (falling edge), CLOCK_MONOTONIC; 0 = none */
+	/* v2 */
+	__u32 timeouts;   /* echo timeouts (no falling edge in time) */
+	/* v3 */
+	__u32 filt_um;    /* median-filtered distance (micrometers) */
+	__u32 outliers;   /* samples rejected by the outlier gate */
+	/* v4 */
+	__u32 xtalk;      /* echo rises without an own trigger (rejected) */
+	/* v5 */
+	__u32 stops;      /* stop threshold breaches */
+	/* v6 */
+	__u32 storms;     /* edge-storm shutdowns of this line */
+};
+
+struct rk_snapshot {
+	__u16 version;      /* RK_SNAPSHOT_VERSION */
+	__u16 hdr_size;     /* sizeof(struct rk_snapshot) */
+	__u16 sensor_size;  /* sizeof(struct rk_snapshot_sensor) */
+	__u16 nsensors;
+	__u32 seq;          /* edges handled */
+	__u32 updates;      /* measurements published; changes wake poll() */
+	__u64 ts_ns;        /* snapshot time, CLOCK_MONOTONIC */
+	struct rk_snapshot_sensor s[];
+};
+
+/* === frames: /sys/kernel/debug/ranger_k/frame ===
+ * One read() returns the last complete frame: struct rk_frame followed by
+ * nsensors struct rk_frame_sensor (step with hdr_size/sensor_size). A
+ * frame covers one trigger cycle (or one frame_window_us window); bit i of
+ * mask is set when sensor i reported in it (a measurement or RK_REC_NO_ECHO),
+ * otherwise its entry is zero. poll() reports EPOLLIN once a newer frame
+ * than the caller's last read from offset 0 exists.
+ */
+#define RK_FRAME_VERSION 1
+
+struct rk_frame_sensor {
+	__u32 dist_um;    /* raw distance (micrometers) */
+	__u32 filt_um;    /* median-filtered distance (micrometers) */
+	__u32 flags;      /* RK_REC_* of the record */
+	__u32 reserved;
+};
+
+struct rk_frame {
+	__u16 version;      /* RK_FRAME_VERSION */
+	__u16 hdr_size;     /* sizeof(struct rk_frame) */
+	__u16 sensor_size;  /* sizeof(struct rk_frame_sensor) */
+	__u16 nsensors;
+	__u32 seq;          /* frame number, 0 = none yet */
+	__u32 reserved;
+	__u64 ts_ns;        /* cycle/window start, CLOCK_MONOTONIC */
+	__u64 pub_ns;       /* publish time, CLOCK_MONOTONIC */
+	__u64 mask;         /* sensors present (bit i = sensor i) */
+	struct rk_frame_sensor s[];
+};
+
+/* === generic netlink: family RK_GENL_NAME, multicast group RK_GENL_MCGRP ===
+ * Resolve the family and group ids with CTRL_CMD_GETFAMILY, join the group
+ * (NETLINK_ADD_MEMBERSHIP) and read RK_GENL_CMD_MEASURE messages. Each
+ * carries one or more RK_GENL_A_REC attributes in publish order (the
+ * module's nl_batch); the payload is a struct rk_rec as in the ring.
+ */
+#define RK_GENL_NAME    "ranger_k"
+#define RK_GENL_VERSION 1
+#define RK_GENL_MCGRP   "measure"
+
+enum {
+	RK_GENL_CMD_UNSPEC,
+	RK_GENL_CMD_MEASURE,  /* kernel -> user, multicast only */
+};
+
+enum {
+	RK_GENL_A_UNSPEC,
+	RK_GENL_A_REC,        /* binary struct rk_rec, repeated */
+	__RK_GENL_A_MAX,
+};
+#define RK_GENL_A_MAX (__RK_GENL_A_MAX - 1)
+
+#endif /* RANGER_K_UAPI_H */
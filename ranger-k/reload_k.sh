@@ -11,10 +11,15 @@ CHIP_DIR="/sys/class/gpio/${CHIP_LINK##*/}"
 BASE=$(cat "$CHIP_DIR/base")
 echo "[i] gpio-sim base=$BASE (label=$(cat "$CHIP_DIR/label"), ngpio=$(cat "$CHIP_DIR/ngpio"))"
 
+# RANGER_K_IIO=y ./reload_k.sh builds the IIO variant (insmod does not resolve deps)
 make -C . clean >/dev/null 2>&1 || true
-make -C .
+make -C . RANGER_K_IIO="${RANGER_K_IIO:-n}"
 sudo rmmod ranger_k 2>/dev/null || true
-sudo insmod ./ranger_k.ko line_gpios=$BASE,$(($BASE+1)),$(($BASE+2)),$(($BASE+3)),$(($BASE+4))
+if [[ "${RANGER_K_IIO:-n}" == "y" ]]; then
+  sudo modprobe -a industrialio industrialio-triggered-buffer kfifo_buf
+fi
+# Lines 0..SENSORS-1 of the gpio-sim chip, looked up by label
+sudo insmod ./ranger_k.ko sim_chip="$(cat "$CHIP_DIR/label")" sim_lines="${SENSORS:-5}" ${RANGER_K_ARGS:-}
 
 echo "[i] dmesg tail:"
 sudo dmesg | tail -n 10
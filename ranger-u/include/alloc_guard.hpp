@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Counting global operator new for --alloc-check. Only the ranger-u-alloc-check
+// build (RANGER_ALLOC_CHECK) links src/alloc_guard.cpp, which replaces every
+// new/delete form with malloc/free; in ranger-u itself these are no-ops and
+// the global allocator is untouched. Allocations are counted only on threads
+// inside an armed Scope, so startup and the out-of-band stats writer are not
+// counted.
+namespace alloc_guard {
+
+#ifdef RANGER_ALLOC_CHECK
+inline constexpr bool enabled = true;
+
+uint64_t count();          // allocations counted so far
+size_t first_size();       // size of the first one (0 = none yet)
+
+class Scope {
+public:
+  explicit Scope(bool arm);
+  ~Scope();
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+private:
+  bool prev_;
+};
+#else
+inline constexpr bool enabled = false;
+
+inline uint64_t count(){ return 0; }
+inline size_t first_size(){ return 0; }
+
+class Scope {
+public:
+  explicit Scope(bool){}
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+};
+#endif
+
+}  // namespace alloc_guard
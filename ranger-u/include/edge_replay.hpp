@@ -0,0 +1,31 @@
+#pragma once
+#include "pulse_measure.hpp"
+#include <cstdio>
+#include <optional>
+#include <string>
+
+struct ReplayEdge {
+  unsigned sensor;
+  EdgeStamp es;
+};
+
+// Recorded or simulated echo edges, one "ts_ns sensor R|F" per line
+// (tools/echo_sim output, pulse_gen --log). "-" reads stdin.
+class EdgeReplay {
+public:
+  explicit EdgeReplay(const std::string& path);
+  ~EdgeReplay();
+
+  EdgeReplay(const EdgeReplay&) = delete;
+  EdgeReplay& operator=(const EdgeReplay&) = delete;
+  EdgeReplay(EdgeReplay&&) = delete;
+  EdgeReplay& operator=(EdgeReplay&&) = delete;
+
+  // next edge, or std::nullopt at end of input; throws on malformed lines
+  std::optional<ReplayEdge> next();
+
+private:
+  FILE* f_{nullptr};
+  bool own_{false};
+  unsigned long lineno_{0};
+};
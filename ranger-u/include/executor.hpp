@@ -0,0 +1,161 @@
+#pragma once
+#include <coroutine>
+#include <csignal>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Single-threaded coroutine executor on epoll (ranger-u --loop coro)
+// - Task: fire-and-forget coroutine. Executor::spawn starts it on the next
+//   run() iteration; its frame lives until the executor is destroyed, and an
+//   exception escaping it ends run() by rethrowing there.
+// - FdEvent (Executor::watch): co_await until the fd is readable. The fd is
+//   edge-triggered, so drain it to EAGAIN before awaiting again.
+// - Timer: timerfd (CLOCK_MONOTONIC) ticks or an absolute deadline.
+// - Broadcast<T>: publish() resumes every awaiting subscriber inline, in
+//   subscription order, before it returns.
+// Spawning and registration allocate; waiting, waking and publishing don't.
+
+class Executor;
+
+class Task {
+public:
+  struct promise_type {
+    Executor* ex = nullptr;
+    std::exception_ptr error;
+
+    Task get_return_object() noexcept { return Task{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    struct Final {
+      bool await_ready() noexcept { return false; }
+      void await_suspend(std::coroutine_handle<promise_type> h) noexcept;
+      void await_resume() noexcept {}
+    };
+    Final final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { error = std::current_exception(); }
+  };
+  using Handle = std::coroutine_handle<promise_type>;
+
+  explicit Task(Handle h) : h_(h) {}
+  Task(Task&& o) noexcept : h_(std::exchange(o.h_, {})) {}
+  Task& operator=(Task&& o) noexcept { if (this != &o){ if (h_) h_.destroy(); h_ = std::exchange(o.h_, {}); } return *this; }
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+  ~Task(){ if (h_) h_.destroy(); }
+
+private:
+  friend class Executor;
+  Handle h_;
+};
+
+// Readiness of one watched fd; co_await it directly
+class FdEvent {
+public:
+  bool await_ready() noexcept { return std::exchange(ready_, false); }
+  void await_suspend(std::coroutine_handle<> h) noexcept { waiter_ = h; }
+  void await_resume() noexcept {}
+  int fd() const { return fd_; }
+
+private:
+  friend class Executor;
+  int fd_ = -1;
+  bool ready_ = false;            // fired while nobody was waiting
+  std::coroutine_handle<> waiter_;
+};
+
+class Executor {
+public:
+  Executor();
+  ~Executor();
+
+  Executor(const Executor&) = delete;
+  Executor& operator=(const Executor&) = delete;
+
+  void spawn(Task t);
+  // Register fd (EPOLLIN | EPOLLET); the caller keeps owning it
+  FdEvent& watch(int fd);
+  // Until stop(), all tasks finished or *interrupt is set (checked after
+  // every wakeup, so a signal handler setting it ends the loop at once)
+  void run(const volatile std::sig_atomic_t* interrupt = nullptr);
+  void stop() { stop_ = true; }
+
+  // co_await ex.yield(): let other ready tasks and pending fds run first
+  struct Yield {
+    Executor& ex;
+    bool await_ready() noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) { ex.ready_.push_back(h); }
+    void await_resume() noexcept {}
+  };
+  Yield yield() { return Yield{*this}; }
+
+private:
+  friend struct Task::promise_type::Final;
+  void resume(std::coroutine_handle<> h);
+
+  int epfd_ = -1;
+  std::vector<Task> tasks_;
+  std::vector<std::unique_ptr<FdEvent>> fds_;
+  std::vector<std::coroutine_handle<>> ready_, running_;
+  size_t live_ = 0;
+  bool stop_ = false;
+  std::exception_ptr error_;
+};
+
+class Timer {
+public:
+  explicit Timer(Executor& ex);
+  ~Timer();
+
+  Timer(const Timer&) = delete;
+  Timer& operator=(const Timer&) = delete;
+
+  void every(int64_t period_ns);  // first tick one period from now
+  void at(int64_t abs_ns);        // one shot at CLOCK_MONOTONIC abs_ns
+
+  // co_await t.wait(): expirations since the last wait (0 after a re-arm)
+  struct Wait {
+    Timer& t;
+    bool await_ready() noexcept { return t.ev_->await_ready(); }
+    void await_suspend(std::coroutine_handle<> h) noexcept { t.ev_->await_suspend(h); }
+    uint64_t await_resume() noexcept;
+  };
+  Wait wait() { return Wait{*this}; }
+
+private:
+  int fd_ = -1;
+  FdEvent* ev_ = nullptr;
+};
+
+template <class T>
+class Broadcast {
+public:
+  explicit Broadcast(size_t max_subscribers){
+    waiting_.reserve(max_subscribers);
+    resuming_.reserve(max_subscribers);
+  }
+
+  // co_await bus.next(): the next published value, valid until the awaiting
+  // task suspends again
+  struct Next {
+    Broadcast& b;
+    bool await_ready() noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) { b.waiting_.push_back(h); }
+    const T& await_resume() noexcept { return *b.value_; }
+  };
+  Next next() { return Next{*this}; }
+
+  void publish(const T& v){
+    value_ = &v;
+    resuming_.swap(waiting_);   // subscribers re-await into waiting_
+    for (auto h : resuming_) h.resume();
+    resuming_.clear();
+    value_ = nullptr;
+  }
+
+private:
+  std::vector<std::coroutine_handle<>> waiting_, resuming_;
+  const T* value_ = nullptr;
+};
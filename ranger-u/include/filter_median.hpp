@@ -1,21 +1,35 @@
 #pragma once
-#include <deque>
 #include <algorithm>
+#include <cstdint>
 #include <optional>
+#include <span>
 #include <vector>
 
+// One median window over caller-owned storage: ring and scratch hold win
+// values each, pos/fill are the ring cursor and fill count. Returns the
+// median of the last win values once the ring is full. Shared by
+// MedianFilter and SensorTable, which keeps all windows in one array.
+inline std::optional<double> median_push(std::span<double> ring, std::span<double> scratch,
+                                         uint32_t& pos, uint32_t& fill, double v){
+  const size_t win = ring.size();
+  ring[pos] = v;
+  pos = pos + 1 == win ? 0 : pos + 1;
+  if (fill < win) fill++;
+  if (fill < win) return std::nullopt;
+  std::copy(ring.begin(), ring.end(), scratch.begin());
+  auto mid = scratch.begin() + static_cast<std::ptrdiff_t>(win/2);
+  std::nth_element(scratch.begin(), mid, scratch.end());
+  return *mid;
+}
+
+// Median of the last win values. Both buffers are sized once here, so
+// push() never allocates.
 class MedianFilter {
 public:
-  explicit MedianFilter(size_t win=5):win_(win){}
-  std::optional<double> push(double v){
-    buf_.push_back(v);
-    if (buf_.size() > win_) buf_.pop_front();
-    if (buf_.size() < win_) return std::nullopt;
-    std::vector<double> tmp(buf_.begin(), buf_.end());
-    std::sort(tmp.begin(), tmp.end());
-    return tmp[tmp.size()/2];
-  }
+  explicit MedianFilter(size_t win=5):buf_(win ? win : 1), tmp_(buf_.size()){}
+  std::optional<double> push(double v){ return median_push(buf_, tmp_, pos_, n_, v); }
 private:
-  size_t win_;
-  std::deque<double> buf_;
+  std::vector<double> buf_;  // ring of the last win values
+  std::vector<double> tmp_;  // scratch for nth_element
+  uint32_t pos_ = 0, n_ = 0;
 };
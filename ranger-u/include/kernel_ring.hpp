@@ -0,0 +1,51 @@
+#pragma once
+#include "ranger_k_uapi.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Zero-copy consumer of the ranger_k record ring (/dev/ranger_k).
+// While records are flowing, drain() touches only shared memory; poll the
+// fd (epoll) only when the ring is empty.
+class KernelRing {
+public:
+  explicit KernelRing(const std::string& dev = "/dev/ranger_k");
+  ~KernelRing();
+
+  KernelRing(const KernelRing&) = delete;
+  KernelRing& operator=(const KernelRing&) = delete;
+  KernelRing(KernelRing&&) = delete;
+  KernelRing& operator=(KernelRing&&) = delete;
+
+  // poll()able fd: EPOLLIN while records are pending
+  int fd() const { return fd_; }
+
+  bool empty() const { return tail_ == head().load(std::memory_order_acquire); }
+
+  // records the kernel dropped because we fell behind
+  uint64_t dropped() const {
+    return std::atomic_ref<__u64>(hdr_->dropped).load(std::memory_order_relaxed);
+  }
+
+  // Calls fn(const rk_rec&) for every pending record; returns count.
+  template <class F>
+  size_t drain(F&& fn){
+    const uint64_t h = head().load(std::memory_order_acquire);
+    size_t n = 0;
+    for (; tail_ != h; ++tail_, ++n) fn(recs_[tail_ & mask_]);
+    if (n) std::atomic_ref<__u64>(hdr_->tail).store(tail_, std::memory_order_release);
+    return n;
+  }
+
+private:
+  std::atomic_ref<__u64> head() const { return std::atomic_ref<__u64>(hdr_->head); }
+
+  int fd_{-1};
+  void* map_{nullptr};
+  size_t map_len_{0};
+  rk_ring_hdr* hdr_{nullptr};
+  const rk_rec* recs_{nullptr};
+  uint64_t mask_{0};
+  uint64_t tail_{0};
+};
@@ -0,0 +1,92 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// CLOCK_MONOTONIC in ns: the clock of gpiod event and ranger_k record stamps
+inline int64_t mono_ns(){
+  timespec ts{};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// Log-linear (HDR-style) latency histogram: 16 linear sub-buckets per power
+// of two, so every value is reported within 1/16 of itself. record() is
+// wait-free (relaxed atomics); readers may run concurrently.
+class LatencyHist {
+public:
+  static constexpr int kSubBits = 4;
+  static constexpr int kSub = 1 << kSubBits;
+  static constexpr int kBuckets = (64 - kSubBits + 1) << kSubBits;
+
+  void record(uint64_t ns){
+    b_[index(ns)].fetch_add(1, std::memory_order_relaxed);
+    n_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t m = max_.load(std::memory_order_relaxed);
+    while (ns > m && !max_.compare_exchange_weak(m, ns, std::memory_order_relaxed)) {}
+  }
+
+  uint64_t count() const { return n_.load(std::memory_order_relaxed); }
+  uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+  double mean() const;
+  // upper bound of the bucket holding quantile q (0..1), capped at max()
+  uint64_t percentile(double q) const;
+
+  static int index(uint64_t v){
+    if (v < kSub) return static_cast<int>(v);
+    int shift = 63 - __builtin_clzll(v) - kSubBits;
+    return ((shift + 1) << kSubBits) + static_cast<int>((v >> shift) - kSub);
+  }
+  static uint64_t upper(int idx);
+
+private:
+  std::array<std::atomic<uint64_t>, kBuckets> b_{};
+  std::atomic<uint64_t> n_{0}, sum_{0}, max_{0};
+};
+
+// Measurement stages, in pipeline order. A measurement is stamped at edge
+// receipt, tracker output, filter output, encode and sink write.
+enum class Stage {
+  EdgeRecv,     // edge timestamp (kernel) -> read by ranger-u
+  RecvTrack,    // read -> pulse tracker output
+  TrackFilter,  // tracker -> median output
+  FilterEncode, // median output -> frame encode starts (includes rate wait)
+  Encode,       // to_json
+  SinkWrite,    // jsonl/stdout/csv write
+  EdgeOut,      // edge timestamp -> sink write done (end to end)
+  Count
+};
+
+struct SensorCounters {
+  std::atomic<uint64_t> edges{0};    // edges (records with --kring) read
+  std::atomic<uint64_t> pulses{0};   // tracker outputs
+  std::atomic<uint64_t> filtered{0}; // median outputs
+  std::atomic<uint64_t> outputs{0};  // measurements that reached a sink
+  std::atomic<uint64_t> edge_out_max{0};
+};
+
+class LatencyStats {
+public:
+  explicit LatencyStats(size_t sensors) : sc_(sensors) {}
+
+  LatencyStats(const LatencyStats&) = delete;
+  LatencyStats& operator=(const LatencyStats&) = delete;
+
+  void record(Stage s, int64_t ns){
+    if (ns >= 0) h_[static_cast<size_t>(s)].record(static_cast<uint64_t>(ns));
+  }
+  SensorCounters& sensor(size_t i){ return sc_[i]; }
+
+  void dump(std::ostream& os) const;
+  // write to path.tmp and rename over path; false on I/O error
+  bool write_file(const std::string& path) const;
+
+private:
+  std::array<LatencyHist, static_cast<size_t>(Stage::Count)> h_;
+  std::vector<SensorCounters> sc_;
+};
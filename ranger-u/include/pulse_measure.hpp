@@ -15,11 +15,16 @@ struct Pulse {
   double distance_m; // computed distance
 };
 
+// Tracker step on caller-owned state: rise_ns is the pending rising edge
+// (-1 = none). A falling edge after a rising edge closes a pulse. Shared by
+// PulseTracker and SensorTable.
+std::optional<Pulse> track_edge(int64_t& rise_ns, const EdgeStamp& es, double sound_speed);
+
 class PulseTracker {
 public:
   explicit PulseTracker(double sound_speed = 343.0); // m/s
-  std::optional<Pulse> on_edge(const EdgeStamp& es);
+  std::optional<Pulse> on_edge(const EdgeStamp& es){ return track_edge(rise_ns_, es, c_); }
 private:
-  std::optional<std::chrono::nanoseconds> t_rise_{};
+  int64_t rise_ns_ = -1;
   double c_;
 };
@@ -0,0 +1,54 @@
+#pragma once
+#include "pulse_measure.hpp"
+#include "telemetry.hpp"
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Hot per-sensor pipeline state, one contiguous array per field (SoA), all
+// sized in the constructor. The tracker and median steps are track_edge and
+// median_push, the same code PulseTracker and MedianFilter run; cold state
+// (GpioLine fds, config) lives elsewhere.
+//
+// With window 5, one sensor's edge touches rise_ns/width_ns (8 B each), a
+// 40 B slice of the filter ring and its frame slot, so a wakeup stays within
+// a few cache lines whatever the sensor count.
+class SensorTable {
+public:
+  explicit SensorTable(size_t n, size_t window = 5, double sound_speed = 343.0);
+
+  size_t size() const { return n_; }
+
+  // Tracker: a falling edge after a rising edge closes a pulse
+  std::optional<Pulse> on_edge(size_t i, const EdgeStamp& es);
+  // Median of sensor i's last window distances once its ring is full
+  std::optional<double> push_filter(size_t i, double v);
+  int64_t last_width_ns(size_t i) const { return width_ns_[i]; }
+
+  // Last output per sensor, in meters: the frame the sinks encode
+  TelemetryFrame& frame() { return frame_; }
+  const TelemetryFrame& frame() const { return frame_; }
+
+  // Stage stamps of the pending (not yet emitted) measurement. mark_fresh
+  // records a new one; the frame that outputs it calls clear_fresh.
+  void mark_fresh(size_t i, int64_t edge_ns, int64_t recv_ns, int64_t filt_ns){
+    edge_ns_[i] = edge_ns; recv_ns_[i] = recv_ns; filt_ns_[i] = filt_ns; fresh_[i] = 1;
+  }
+  void clear_fresh(size_t i) { fresh_[i] = 0; }
+  bool fresh(size_t i) const { return fresh_[i] != 0; }
+  int64_t edge_ns(size_t i) const { return edge_ns_[i]; }  // edge stamp, -1 = virtual time
+  int64_t recv_ns(size_t i) const { return recv_ns_[i]; }  // ranger-u read that edge
+  int64_t filt_ns(size_t i) const { return filt_ns_[i]; }  // the median produced it
+
+private:
+  size_t n_, win_;
+  double c_;                     // speed of sound, m/s
+  std::vector<int64_t> rise_ns_; // pending rising edge, -1 = none
+  std::vector<int64_t> width_ns_;// last pulse width
+  std::vector<double> ring_;     // n * win, sensor i at [i*win, (i+1)*win)
+  std::vector<uint32_t> pos_, fill_;
+  std::vector<double> scratch_;  // win, for nth_element
+  std::vector<int64_t> edge_ns_, recv_ns_, filt_ns_;
+  std::vector<uint8_t> fresh_;   // filtered since the last frame
+  TelemetryFrame frame_;
+};
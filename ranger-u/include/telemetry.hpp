@@ -1,11 +1,19 @@
 #pragma once
-#include <array>
 #include <cstdint>
 #include <string>
+#include <vector>
 
-// Minimal format for ISO-TP: 5 float32 (meters)
+// One float32 (meters) per sensor; ranger-can packs the first 5 for ISO-TP
 struct TelemetryFrame {
-  std::array<float,5> dist_m;
+  std::vector<float> dist_m;
 };
 
+// Append to out; once out has the capacity for a frame these don't allocate.
+// Numbers are printed like iostreams' default (%g, 6 significant digits).
+void append_json(std::string& out, const TelemetryFrame& tf);
+// "ts_ns,d0,d1,...\n"
+void append_csv_row(std::string& out, long long ts_ns, const TelemetryFrame& tf);
+void append_int(std::string& out, long long v);
+
 std::string to_json(const TelemetryFrame& tf);
+std::string to_csv_row(long long ts_ns, const TelemetryFrame& tf);
@@ -0,0 +1,32 @@
+#include "edge_replay.hpp"
+#include <stdexcept>
+
+EdgeReplay::EdgeReplay(const std::string& path) {
+  if (path == "-") {
+    f_ = stdin;
+  } else {
+    f_ = std::fopen(path.c_str(), "r");
+    if (!f_) throw std::runtime_error("open " + path + " failed");
+    own_ = true;
+  }
+}
+
+EdgeReplay::~EdgeReplay() {
+  if (own_) std::fclose(f_);
+}
+
+std::optional<ReplayEdge> EdgeReplay::next() {
+  char line[128];
+  while (std::fgets(line, sizeof(line), f_)) {
+    ++lineno_;
+    if (line[0] == '#' || line[0] == '\n') continue;
+    long long ts;
+    unsigned sensor;
+    char kind;
+    if (std::sscanf(line, "%lld %u %c", &ts, &sensor, &kind) != 3 || (kind != 'R' && kind != 'F'))
+      throw std::runtime_error("replay: bad edge on line " + std::to_string(lineno_));
+    return ReplayEdge{sensor, EdgeStamp{kind == 'R' ? Edge::Rising : Edge::Falling,
+                                        std::chrono::nanoseconds(ts)}};
+  }
+  return std::nullopt;
+}
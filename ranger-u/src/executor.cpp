@@ -0,0 +1,104 @@
+#include "executor.hpp"
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <stdexcept>
+
+void Task::promise_type::Final::await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+  Executor* ex = h.promise().ex;
+  ex->live_--;
+  if (h.promise().error && !ex->error_) ex->error_ = h.promise().error;
+}
+
+Executor::Executor(){
+  epfd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epfd_ < 0) throw std::runtime_error("epoll_create1 failed");
+  ready_.reserve(64);
+  running_.reserve(64);
+}
+
+Executor::~Executor(){
+  tasks_.clear();  // destroy frames before the fds they watch
+  if (epfd_ >= 0) ::close(epfd_);
+}
+
+void Executor::spawn(Task t){
+  t.h_.promise().ex = this;
+  ready_.push_back(t.h_);
+  tasks_.push_back(std::move(t));
+  live_++;
+  if (ready_.capacity() < tasks_.size()){
+    ready_.reserve(2 * tasks_.size());
+    running_.reserve(2 * tasks_.size());
+  }
+}
+
+FdEvent& Executor::watch(int fd){
+  auto ev = std::make_unique<FdEvent>();
+  ev->fd_ = fd;
+  epoll_event e{};
+  e.events = EPOLLIN | EPOLLET;
+  e.data.ptr = ev.get();
+  if (epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &e) < 0) throw std::runtime_error("epoll_ctl failed");
+  fds_.push_back(std::move(ev));
+  return *fds_.back();
+}
+
+void Executor::resume(std::coroutine_handle<> h){
+  h.resume();
+  if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+}
+
+void Executor::run(const volatile std::sig_atomic_t* interrupt){
+  epoll_event evs[64];
+  while (!stop_ && live_ > 0 && !(interrupt && *interrupt)){
+    running_.swap(ready_);
+    for (auto h : running_) resume(h);
+    running_.clear();
+    if (stop_ || live_ == 0) break;
+
+    // only block when nothing is ready to run
+    int n = epoll_wait(epfd_, evs, 64, ready_.empty() ? -1 : 0);
+    if (n < 0){
+      if (errno == EINTR) continue;
+      throw std::runtime_error("epoll_wait failed");
+    }
+    for (int i = 0; i < n; i++){
+      FdEvent* f = static_cast<FdEvent*>(evs[i].data.ptr);
+      if (f->waiter_) resume(std::exchange(f->waiter_, {}));
+      else f->ready_ = true;
+    }
+  }
+}
+
+Timer::Timer(Executor& ex){
+  fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (fd_ < 0) throw std::runtime_error("timerfd_create failed");
+  ev_ = &ex.watch(fd_);
+}
+
+Timer::~Timer(){
+  if (fd_ >= 0) ::close(fd_);  // closing drops it from the epoll set
+}
+
+static timespec to_ts(int64_t ns){
+  return timespec{ static_cast<time_t>(ns / 1000000000LL), static_cast<long>(ns % 1000000000LL) };
+}
+
+void Timer::every(int64_t period_ns){
+  itimerspec its{ to_ts(period_ns), to_ts(period_ns) };
+  if (timerfd_settime(fd_, 0, &its, nullptr) < 0) throw std::runtime_error("timerfd_settime failed");
+}
+
+void Timer::at(int64_t abs_ns){
+  // 0 would disarm: a deadline at or before the epoch fires at once
+  itimerspec its{ {0, 0}, to_ts(abs_ns > 0 ? abs_ns : 1) };
+  if (timerfd_settime(fd_, TFD_TIMER_ABSTIME, &its, nullptr) < 0) throw std::runtime_error("timerfd_settime failed");
+}
+
+uint64_t Timer::Wait::await_resume() noexcept {
+  uint64_t n = 0;
+  if (::read(t.fd_, &n, sizeof(n)) != static_cast<ssize_t>(sizeof(n))) n = 0;
+  return n;
+}
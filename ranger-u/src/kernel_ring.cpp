@@ -0,0 +1,38 @@
+#include "kernel_ring.hpp"
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+KernelRing::KernelRing(const std::string& dev) {
+  fd_ = ::open(dev.c_str(), O_RDWR | O_CLOEXEC);
+  if (fd_ < 0) throw std::runtime_error("open " + dev + " failed");
+
+  // Map the header page first to learn the ring geometry
+  const size_t pg = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  void* p = mmap(nullptr, pg, PROT_READ, MAP_SHARED, fd_, 0);
+  if (p == MAP_FAILED){ ::close(fd_); throw std::runtime_error("mmap ring header failed"); }
+  rk_ring_hdr h = *static_cast<const rk_ring_hdr*>(p);
+  munmap(p, pg);
+
+  if (h.magic != RK_RING_MAGIC || h.version != RK_RING_VERSION || h.rec_size != sizeof(rk_rec) ||
+      h.nrec == 0 || (h.nrec & (h.nrec - 1)) != 0){
+    ::close(fd_);
+    throw std::runtime_error("ranger_k ring ABI mismatch");
+  }
+
+  map_len_ = h.data_offset + static_cast<size_t>(h.nrec) * h.rec_size;
+  map_ = mmap(nullptr, map_len_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (map_ == MAP_FAILED){ map_ = nullptr; ::close(fd_); throw std::runtime_error("mmap ring failed"); }
+
+  hdr_  = static_cast<rk_ring_hdr*>(map_);
+  recs_ = reinterpret_cast<const rk_rec*>(static_cast<const char*>(map_) + h.data_offset);
+  mask_ = h.nrec - 1;
+  // the module resets tail to head on open; start from there
+  tail_ = std::atomic_ref<__u64>(hdr_->tail).load(std::memory_order_acquire);
+}
+
+KernelRing::~KernelRing() {
+  if (map_) munmap(map_, map_len_);
+  if (fd_ >= 0) ::close(fd_);
+}
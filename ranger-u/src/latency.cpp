@@ -0,0 +1,63 @@
+#include "latency.hpp"
+#include <cstdio>
+#include <fstream>
+
+static const char* const kStageNames[] = {
+  "edge_recv", "recv_track", "track_filter", "filter_encode", "encode", "sink_write", "edge_out",
+};
+static_assert(sizeof(kStageNames) / sizeof(kStageNames[0]) == static_cast<size_t>(Stage::Count));
+
+uint64_t LatencyHist::upper(int idx){
+  if (idx < kSub) return static_cast<uint64_t>(idx);
+  int shift = (idx >> kSubBits) - 1;
+  uint64_t sub = static_cast<uint64_t>(idx & (kSub - 1)) + kSub;
+  return ((sub + 1) << shift) - 1;
+}
+
+double LatencyHist::mean() const {
+  uint64_t n = count();
+  return n ? static_cast<double>(sum_.load(std::memory_order_relaxed)) / n : 0.0;
+}
+
+uint64_t LatencyHist::percentile(double q) const {
+  uint64_t n = count();
+  if (!n) return 0;
+  uint64_t rank = static_cast<uint64_t>(q * n);
+  if (rank >= n) rank = n - 1;
+  uint64_t seen = 0;
+  for (int i = 0; i < kBuckets; i++){
+    seen += b_[i].load(std::memory_order_relaxed);
+    if (seen > rank){
+      uint64_t u = upper(i), m = max();
+      return u < m ? u : m;
+    }
+  }
+  return max();
+}
+
+void LatencyStats::dump(std::ostream& os) const {
+  os << "# stage count p50_ns p99_ns p999_ns max_ns mean_ns\n";
+  for (size_t i = 0; i < h_.size(); i++){
+    const LatencyHist& h = h_[i];
+    os << kStageNames[i] << " " << h.count() << " " << h.percentile(0.50) << " " << h.percentile(0.99)
+       << " " << h.percentile(0.999) << " " << h.max() << " " << static_cast<uint64_t>(h.mean()) << "\n";
+  }
+  os << "# sensor edges pulses filtered outputs edge_out_max_ns\n";
+  for (size_t i = 0; i < sc_.size(); i++){
+    const SensorCounters& c = sc_[i];
+    os << i << " " << c.edges.load(std::memory_order_relaxed) << " " << c.pulses.load(std::memory_order_relaxed)
+       << " " << c.filtered.load(std::memory_order_relaxed) << " " << c.outputs.load(std::memory_order_relaxed)
+       << " " << c.edge_out_max.load(std::memory_order_relaxed) << "\n";
+  }
+}
+
+bool LatencyStats::write_file(const std::string& path) const {
+  std::string tmp = path + ".tmp";
+  {
+    std::ofstream f(tmp, std::ios::out | std::ios::trunc);
+    if (!f) return false;
+    dump(f);
+    if (!f.flush()) return false;
+  }
+  return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
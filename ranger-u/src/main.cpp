@@ -1,27 +1,25 @@
 #include "gpio_line.hpp"
-#include "pulse_measure.hpp"
-#include "filter_median.hpp"
+#include "sensor_table.hpp"
 #include "telemetry.hpp"
+#include "kernel_ring.hpp"
+#include "edge_replay.hpp"
+#include "latency.hpp"
+#include "alloc_guard.hpp"
+#include "executor.hpp"
 
 #include <sys/epoll.h>
+#include <algorithm>
+#include <time.h>
 #include <memory>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <csignal>
 
-struct SensorCtx {
-  std::unique_ptr<GpioLine> gl;
-  PulseTracker tracker;
-  MedianFilter mf;
-  explicit SensorCtx(const GpioLineCfg& cfg)
-      : gl(std::make_unique<GpioLine>(cfg)), tracker(343.0), mf(5) {} // window=5
-  SensorCtx(const SensorCtx&) = delete;
-  SensorCtx& operator=(const SensorCtx&) = delete;
-};
-
 static volatile std::sig_atomic_t g_stop = 0;
 static void on_sigint(int){ g_stop = 1; }
+static volatile std::sig_atomic_t g_dump = 0;
+static void on_sigusr1(int){ g_dump = 1; }
 
 // v1 event -> our EdgeStamp
 static EdgeStamp edge_from(const gpiod_line_event& ev){
@@ -44,6 +42,13 @@ struct Args {
   std::string jsonl_path;         // empty = stdout only
   std::string csv_path;           // optional
   double rate_hz = 10.0;          // periodic print rate
+  std::string kring;              // ranger_k ring device; empty = libgpiod
+  std::string replay;             // edge file ("-" = stdin); empty = live input
+  std::string stats_path;         // latency stats file, rewritten every second
+  bool with_ts = false;           // add stage stamps to JSONL lines
+  bool replay_rt = false;         // pace --replay in real time
+  bool alloc_check = false;       // count heap allocations after warmup, exit 3 if any
+  std::string loop = "classic";   // classic | coro (coroutine tasks on Executor)
 };
 
 static Args parse_args(int argc, char** argv){
@@ -57,33 +62,64 @@ static Args parse_args(int argc, char** argv){
     else if (k=="--jsonl") a.jsonl_path = need("--jsonl");
     else if (k=="--csv") a.csv_path = need("--csv");
     else if (k=="--rate-hz") a.rate_hz = std::stod(need("--rate-hz"));
+    else if (k=="--kring") a.kring = need("--kring");
+    else if (k=="--replay") a.replay = need("--replay");
+    else if (k=="--stats") a.stats_path = need("--stats");
+    else if (k=="--with-ts") a.with_ts = true;
+    else if (k=="--replay-rt") a.replay_rt = true;
+    else if (k=="--alloc-check") a.alloc_check = true;
+    else if (k=="--loop") a.loop = need("--loop");
     else if (k=="-h" || k=="--help"){
       std::cout <<
       "Usage: ranger-u [--chip /dev/gpiochipN] [--lines 0,1,...] [--duration SEC]\n"
-      "                [--jsonl out.jsonl] [--csv out.csv] [--rate-hz N]\n";
+      "                [--jsonl out.jsonl] [--csv out.csv] [--rate-hz N]\n"
+      "                [--kring /dev/ranger_k]   (use ranger_k filtered measurements instead of\n"
+      "                                           libgpiod; --lines then only sets the sensor count)\n"
+      "                [--replay edges.txt|-]    (\"ts_ns sensor R|F\" edges from echo_sim or pulse_gen\n"
+      "                                           --log, run in virtual time as fast as possible;\n"
+      "                                           --lines sets the sensor count, --duration is ignored)\n"
+      "                [--replay-rt]             (play --replay edges in real time; each edge is\n"
+      "                                           stamped with its injection time)\n"
+      "                [--stats stats.txt]       (per-stage latency percentiles + per-sensor counters,\n"
+      "                                           rewritten every second; also on SIGUSR1 and at exit\n"
+      "                                           to stderr)\n"
+      "                [--with-ts]               (JSONL lines carry \"t\":{edge,recv,filt,out} of the\n"
+      "                                           oldest fresh measurement, for ranger-can --with-ts)\n"
+      "                [--alloc-check]           (ranger-u-alloc-check build only: count heap allocations\n"
+      "                                           on the edge -> sink path after 1 s of frames; report\n"
+      "                                           at exit, exit code 3 if any)\n"
+      "                [--loop classic|coro]     (coro: one coroutine task per sensor, per sink and for\n"
+      "                                           the output tick on an epoll/timerfd executor)\n";
       std::exit(0);
     }
   }
+  if (a.alloc_check && !alloc_guard::enabled){ std::cerr<<"--alloc-check needs the ranger-u-alloc-check build\n"; std::exit(2); }
+  if (a.loop != "classic" && a.loop != "coro"){ std::cerr<<"--loop must be classic or coro\n"; std::exit(2); }
   return a;
 }
 
 int main(int argc, char** argv){
   std::signal(SIGINT, on_sigint);
+  std::signal(SIGUSR1, on_sigusr1);
   auto args = parse_args(argc, argv);
 
-  // Build sensor set
-  std::vector<std::unique_ptr<SensorCtx>> sensors;
-  sensors.reserve(args.lines.size());
+  // Hot per-sensor state in one SoA table (tracker, median window=5, stamps);
+  // the libgpiod lines are cold and only needed to read events
+  SensorTable st(args.lines.size(), 5, 343.0);
+  std::vector<std::unique_ptr<GpioLine>> gpio;
 
-  int epfd = epoll_create1(0);
-  if (epfd < 0){ perror("epoll_create1"); return 1; }
-
-  for (size_t i=0;i<args.lines.size();++i){
-    GpioLineCfg cfg{ args.chip, args.lines[i], true, true, "ranger-u" };
-    sensors.emplace_back(std::make_unique<SensorCtx>(cfg));
-    int fd = sensors.back()->gl->fd();
-    epoll_event ev{}; ev.events = EPOLLIN; ev.data.fd = fd;
-    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0){ perror("epoll_ctl"); return 1; }
+  // Inputs; each loop registers their fds with its own epoll set
+  std::unique_ptr<KernelRing> kring;
+  std::unique_ptr<EdgeReplay> replay;
+  if (!args.replay.empty()){
+    replay = std::make_unique<EdgeReplay>(args.replay);
+  } else if (!args.kring.empty()){
+    kring = std::make_unique<KernelRing>(args.kring);
+  } else {
+    for (size_t i=0;i<args.lines.size();++i){
+      GpioLineCfg cfg{ args.chip, args.lines[i], true, true, "ranger-u" };
+      gpio.push_back(std::make_unique<GpioLine>(cfg));
+    }
   }
 
   // Outputs
@@ -96,59 +132,327 @@ int main(int argc, char** argv){
     csv_file << "\n";
   }
 
-  TelemetryFrame tf{}; // meters
+  TelemetryFrame& tf = st.frame(); // meters
+  auto lat = std::make_unique<LatencyStats>(st.size());
   auto t0 = std::chrono::steady_clock::now();
   auto next_print = t0;
   using SteadyDur = std::chrono::steady_clock::duration;
   auto print_interval = std::chrono::duration_cast<SteadyDur>(std::chrono::duration<double>(1.0 / args.rate_hz));
 
+  // --alloc-check: the edge -> sink path runs armed once warmup is over
+  bool steady = false;
+  uint64_t frames = 0;
+  const uint64_t warmup_frames = std::max<uint64_t>(1, static_cast<uint64_t>(args.rate_hz));
+
+  // recv_ns: when ranger-u read the edge; edge_ns: its kernel stamp, or -1
+  auto on_edge = [&](size_t idx, const EdgeStamp& es, int64_t recv_ns, int64_t edge_ns){
+    alloc_guard::Scope guard(steady);
+    SensorCounters& c = lat->sensor(idx);
+    c.edges.fetch_add(1, std::memory_order_relaxed);
+    if (edge_ns >= 0) lat->record(Stage::EdgeRecv, recv_ns - edge_ns);
+    if (auto p = st.on_edge(idx, es)){
+      int64_t t_track = mono_ns();
+      lat->record(Stage::RecvTrack, t_track - recv_ns);
+      c.pulses.fetch_add(1, std::memory_order_relaxed);
+      if (auto m = st.push_filter(idx, p->distance_m)){
+        tf.dist_m[idx] = static_cast<float>(*m);
+        int64_t t_filt = mono_ns();
+        lat->record(Stage::TrackFilter, t_filt - t_track);
+        c.filtered.fetch_add(1, std::memory_order_relaxed);
+        st.mark_fresh(idx, edge_ns, recv_ns, t_filt);
+      }
+    }
+  };
+
+  // A frame: frame_begin, then every sink encodes and writes it, then
+  // frame_end. The classic loop calls the sinks in order; --loop coro
+  // broadcasts the frame to one task per sink.
+  // Output lines are built in reused buffers: no allocation once they have grown
+  std::string line, csv_row;
+  line.reserve(160 + 16 * st.size());
+  csv_row.reserve(32 + 16 * st.size());
+  int64_t t_write = 0;  // the JSONL/stdout sink finished encoding
+  auto frame_begin = [&]{ return mono_ns(); };
+  auto sink_json = [&](long long ns){
+    alloc_guard::Scope guard(steady);
+    line.clear();
+    if (jsonl_file.is_open()){
+      line += "{\"ts_ns\":";
+      append_int(line, ns);
+      line += ",\"data\":";
+    }
+    append_json(line, tf);
+    t_write = mono_ns();
+    if (jsonl_file.is_open()){
+      if (args.with_ts){
+        size_t o = st.size();
+        for (size_t i=0;i<st.size();++i)
+          if (st.fresh(i) && st.edge_ns(i) >= 0 && (o == st.size() || st.edge_ns(i) < st.edge_ns(o))) o = i;
+        if (o < st.size()){
+          line += ",\"t\":{\"edge\":"; append_int(line, st.edge_ns(o));
+          line += ",\"recv\":"; append_int(line, st.recv_ns(o));
+          line += ",\"filt\":"; append_int(line, st.filt_ns(o));
+          line += ",\"out\":"; append_int(line, t_write);
+          line += '}';
+        }
+      }
+      line += "}\n";
+      jsonl_file.write(line.data(), static_cast<std::streamsize>(line.size()));
+      jsonl_file.flush();  // a pipe to ranger-can must not sit on frames
+    } else {
+      line += '\n';
+      std::cout.write(line.data(), static_cast<std::streamsize>(line.size()));
+      std::cout.flush();
+    }
+  };
+  auto sink_csv = [&](long long ns){
+    alloc_guard::Scope guard(steady);
+    csv_row.clear();
+    append_csv_row(csv_row, ns, tf);
+    csv_file.write(csv_row.data(), static_cast<std::streamsize>(csv_row.size()));
+  };
+  auto frame_end = [&](int64_t t_enc){
+    alloc_guard::Scope guard(steady);
+    int64_t t_out = mono_ns();
+    lat->record(Stage::Encode, t_write - t_enc);
+    lat->record(Stage::SinkWrite, t_out - t_write);
+    for (size_t i=0;i<st.size();++i){
+      if (!st.fresh(i)) continue;
+      st.clear_fresh(i);
+      SensorCounters& c = lat->sensor(i);
+      c.outputs.fetch_add(1, std::memory_order_relaxed);
+      lat->record(Stage::FilterEncode, t_enc - st.filt_ns(i));
+      if (st.edge_ns(i) < 0) continue;
+      uint64_t e2e = static_cast<uint64_t>(t_out - st.edge_ns(i));
+      lat->record(Stage::EdgeOut, e2e);
+      if (e2e > c.edge_out_max.load(std::memory_order_relaxed)) c.edge_out_max.store(e2e, std::memory_order_relaxed);
+    }
+    if (args.alloc_check && !steady && ++frames >= warmup_frames) steady = true;
+  };
+  auto emit = [&](long long ns){
+    int64_t t_enc = frame_begin();
+    sink_json(ns);
+    if (csv_file.is_open()) sink_csv(ns);
+    frame_end(t_enc);
+  };
+
+  // ranger_k record: tracker and median ran in the module, so only the
+  // receipt and output stages are measured here
+  auto on_record = [&](const rk_rec& r, int64_t t_recv){
+    if (r.sensor >= st.size()) return;
+    lat->sensor(r.sensor).edges.fetch_add(1, std::memory_order_relaxed);
+    if (r.flags & RK_REC_NO_ECHO) return;  // keep the last filtered value
+    tf.dist_m[r.sensor] = static_cast<float>(r.filt_um * 1e-6);  // median done in the module
+    lat->record(Stage::EdgeRecv, t_recv - static_cast<int64_t>(r.ts_ns));
+    st.mark_fresh(r.sensor, static_cast<int64_t>(r.ts_ns), t_recv, t_recv);
+  };
+
+  // SIGUSR1 / exit -> stderr; --stats file once per second
+  auto next_stats = t0 + std::chrono::seconds(1);
+  auto service_stats = [&](bool final){
+    if (g_dump || final){
+      g_dump = 0;
+      std::cerr << "# ranger-u latency (ns)\n";
+      lat->dump(std::cerr);
+      if (kring) std::cerr << "# kring dropped=" << kring->dropped() << "\n";
+    }
+    if (args.stats_path.empty()) return;
+    auto now = std::chrono::steady_clock::now();
+    if (final || now >= next_stats){
+      if (!lat->write_file(args.stats_path)) std::cerr << "[warn] cannot write " << args.stats_path << "\n";
+      next_stats = now + std::chrono::seconds(1);
+    }
+  };
+
+  auto finish = [&]{
+    service_stats(true);
+    if (!args.alloc_check) return 0;
+    uint64_t n = alloc_guard::count();
+    std::cerr << "# alloc-check: " << n << " heap allocations after warmup";
+    if (n) std::cerr << " (first: " << alloc_guard::first_size() << " bytes)";
+    std::cerr << (steady ? "\n" : " [warmup not reached]\n");
+    return n ? 3 : 0;
+  };
+
+  const long long step = std::chrono::duration_cast<std::chrono::nanoseconds>(print_interval).count();
+
+  if (args.loop == "coro"){
+    // Same pipeline as the loops below, as tasks on one executor: every input
+    // fd and the output tick is a task awaiting its event, every sink a task
+    // awaiting frames. A new source or sink is one more spawn().
+    Executor ex;
+    struct Frame { long long ns; };
+    Broadcast<Frame> frames_bus(2);
+    auto publish = [&](long long ns){
+      int64_t t_enc = frame_begin();
+      frames_bus.publish(Frame{ns});
+      frame_end(t_enc);
+    };
+
+    auto json_task = [&]() -> Task {
+      for (;;){ const Frame& f = co_await frames_bus.next(); sink_json(f.ns); }
+    };
+    auto csv_task = [&]() -> Task {
+      for (;;){ const Frame& f = co_await frames_bus.next(); sink_csv(f.ns); }
+    };
+    // Edge-triggered: drain to EAGAIN, then wait for the next wakeup
+    auto line_task = [&](size_t idx) -> Task {
+      FdEvent& ev = ex.watch(gpio[idx]->fd());
+      for (;;){
+        co_await ev;
+        while (auto evopt = gpio[idx]->read_event()){
+          EdgeStamp es = edge_from(*evopt);
+          on_edge(idx, es, mono_ns(), es.ts.count());
+        }
+      }
+    };
+    auto kring_task = [&]() -> Task {
+      FdEvent& ev = ex.watch(kring->fd());
+      for (;;){
+        co_await ev;
+        alloc_guard::Scope guard(steady);
+        do {
+          int64_t t_recv = mono_ns();
+          kring->drain([&](const rk_rec& r){ on_record(r, t_recv); });
+        } while (!kring->empty());
+      }
+    };
+    auto tick_task = [&]() -> Task {
+      Timer tick(ex);
+      tick.every(step);
+      for (;;){
+        co_await tick.wait();
+        publish(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count());
+      }
+    };
+    // Virtual time as in the classic replay loop; --replay-rt waits on a
+    // timerfd deadline instead of clock_nanosleep
+    auto replay_task = [&]() -> Task {
+      Timer pace(ex);
+      long long first = -1, next_ns = 0;
+      int64_t base = 0;
+      uint32_t n = 0;
+      while (auto e = replay->next()){
+        if (e->sensor >= st.size()) continue;
+        long long ts = e->es.ts.count();
+        if (first < 0){ first = next_ns = ts; base = mono_ns(); }
+        for (; ts >= next_ns; next_ns += step){
+          if (args.replay_rt){ pace.at(base + (next_ns - first)); co_await pace.wait(); }
+          publish(next_ns - first);
+        }
+        int64_t edge_ns = -1;
+        if (args.replay_rt){ edge_ns = base + (ts - first); pace.at(edge_ns); co_await pace.wait(); }
+        on_edge(e->sensor, e->es, mono_ns(), edge_ns);
+        if (!args.replay_rt && ++n % 1024 == 0) co_await ex.yield();  // let housekeeping run
+      }
+      ex.stop();
+    };
+    auto housekeeping_task = [&]() -> Task {
+      Timer t(ex);
+      t.every(100'000'000);
+      for (;;){
+        co_await t.wait();
+        service_stats(false);
+        if (!replay && args.duration_sec > 0 &&
+            std::chrono::steady_clock::now() - t0 >= std::chrono::seconds(args.duration_sec)) ex.stop();
+      }
+    };
+
+    // Sinks first: they must be waiting on the bus before the first frame
+    ex.spawn(json_task());
+    if (csv_file.is_open()) ex.spawn(csv_task());
+    if (replay) ex.spawn(replay_task());
+    else {
+      if (kring) ex.spawn(kring_task());
+      for (size_t i=0;i<gpio.size();++i) ex.spawn(line_task(i));
+      ex.spawn(tick_task());
+    }
+    ex.spawn(housekeeping_task());
+    ex.run(&g_stop);
+    return finish();
+  }
+
+  if (replay){
+    // Virtual time: frames every 1/rate_hz of edge time, from the first edge.
+    // With --replay-rt, edge time t runs at base + (t - first) on CLOCK_MONOTONIC.
+    long long first = -1, next_ns = 0;
+    int64_t base = 0;
+    auto sleep_to = [&](long long vts){
+      int64_t at = base + (vts - first);
+      timespec ts{ static_cast<time_t>(at / 1000000000LL), static_cast<long>(at % 1000000000LL) };
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR && !g_stop) {}
+      return at;
+    };
+    while (!g_stop){
+      auto e = replay->next();
+      if (!e) break;
+      if (e->sensor >= st.size()) continue;
+      long long ts = e->es.ts.count();
+      if (first < 0){ first = next_ns = ts; base = mono_ns(); }
+      for (; ts >= next_ns; next_ns += step){
+        if (args.replay_rt) sleep_to(next_ns);
+        emit(next_ns - first);
+      }
+      int64_t edge_ns = args.replay_rt ? sleep_to(ts) : -1;
+      on_edge(e->sensor, e->es, mono_ns(), edge_ns);
+      service_stats(false);
+    }
+    return finish();
+  }
+
+  int epfd = epoll_create1(0);
+  if (epfd < 0){ perror("epoll_create1"); return 1; }
+  if (kring){
+    epoll_event ev{}; ev.events = EPOLLIN; ev.data.fd = kring->fd();
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, kring->fd(), &ev) < 0){ perror("epoll_ctl"); return 1; }
+  }
+  for (size_t i=0;i<gpio.size();++i){
+    // the event carries the sensor index: only ready lines are read
+    epoll_event ev{}; ev.events = EPOLLIN; ev.data.u64 = i;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, gpio[i]->fd(), &ev) < 0){ perror("epoll_ctl"); return 1; }
+  }
+
   while(!g_stop){
     if (args.duration_sec > 0){
       auto now = std::chrono::steady_clock::now();
       if (std::chrono::duration_cast<std::chrono::seconds>(now - t0).count() >= args.duration_sec) break;
     }
 
-    epoll_event events[16];
-    int n = epoll_wait(epfd, events, 16, 10);
-    if (n < 0){
-      if (errno==EINTR) continue;
-      perror("epoll_wait"); break;
+    // Kernel ring: only sleep in epoll when there is nothing to consume
+    epoll_event events[64];
+    int nev = 0;
+    if (!kring || kring->empty()){
+      nev = epoll_wait(epfd, events, 64, 10);
+      if (nev < 0){
+        if (errno==EINTR) continue;
+        perror("epoll_wait"); break;
+      }
     }
 
-    // Drain events from ALL sensors (non-blocking read)
-    for (size_t idx = 0; idx < sensors.size(); ++idx){
-      while (true){
-        auto evopt = sensors[idx]->gl->read_event();
-        if (!evopt) break;
-        EdgeStamp es = edge_from(*evopt);
-        if (auto p = sensors[idx]->tracker.on_edge(es)){
-          if (auto m = sensors[idx]->mf.push(p->distance_m)){
-            tf.dist_m[idx] = static_cast<float>(*m);
-          }
+    service_stats(false);
+
+    alloc_guard::Scope guard(steady);
+    if (kring){
+      int64_t t_recv = mono_ns();
+      kring->drain([&](const rk_rec& r){ on_record(r, t_recv); });
+    } else {
+      // Drain the lines epoll reported (level-triggered: the rest come next round)
+      for (int k = 0; k < nev; ++k){
+        const size_t idx = static_cast<size_t>(events[k].data.u64);
+        while (true){
+          auto evopt = gpio[idx]->read_event();
+          if (!evopt) break;
+          EdgeStamp es = edge_from(*evopt);
+          on_edge(idx, es, mono_ns(), es.ts.count());
         }
       }
     }
 
     auto now = std::chrono::steady_clock::now();
     if (now >= next_print){
-      auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - t0).count();
-
-      std::string j = to_json(tf);
-      if (jsonl_file.is_open()){
-        jsonl_file << "{\"ts_ns\":" << ns << ",\"data\":" << j << "}\n";
-      } else {
-        std::cout << j << "\n";
-        std::cout.flush();
-      }
-
-      if (csv_file.is_open()){
-        csv_file << ns;
-        for (size_t i=0;i<sensors.size();++i) csv_file << "," << tf.dist_m[i];
-        csv_file << "\n";
-      }
-
+      emit(std::chrono::duration_cast<std::chrono::nanoseconds>(now - t0).count());
       next_print += print_interval;
     }
   }
-  return 0;
+  return finish();
 }
@@ -2,18 +2,16 @@
 
 PulseTracker::PulseTracker(double sound_speed) : c_(sound_speed) {}
 
-std::optional<Pulse> PulseTracker::on_edge(const EdgeStamp& es){
+std::optional<Pulse> track_edge(int64_t& rise_ns, const EdgeStamp& es, double sound_speed){
   if (es.edge == Edge::Rising){
-    t_rise_ = es.ts;
+    rise_ns = es.ts.count();
     return std::nullopt;
   }
-  if (es.edge == Edge::Falling && t_rise_){
-    auto w = es.ts - *t_rise_;
-    t_rise_.reset();
-    // HC-SR04: pulse width equals round-trip time of sound
-    double t_s = w.count() * 1e-9;
-    double dist = (c_ * t_s) / 2.0; // meters
-    return Pulse{w, dist};
-  }
-  return std::nullopt;
+  if (rise_ns < 0) return std::nullopt;
+  std::chrono::nanoseconds w(es.ts.count() - rise_ns);
+  rise_ns = -1;
+  // HC-SR04: pulse width equals round-trip time of sound
+  double t_s = w.count() * 1e-9;
+  double dist = (sound_speed * t_s) / 2.0; // meters
+  return Pulse{w, dist};
 }
@@ -0,0 +1,19 @@
+#include "sensor_table.hpp"
+#include "filter_median.hpp"
+
+SensorTable::SensorTable(size_t n, size_t window, double sound_speed)
+    : n_(n), win_(window ? window : 1), c_(sound_speed),
+      rise_ns_(n, -1), width_ns_(n, 0), ring_(n * win_), pos_(n, 0), fill_(n, 0), scratch_(win_),
+      edge_ns_(n, -1), recv_ns_(n, 0), filt_ns_(n, 0), fresh_(n, 0) {
+  frame_.dist_m.assign(n, 0.0f);
+}
+
+std::optional<Pulse> SensorTable::on_edge(size_t i, const EdgeStamp& es){
+  auto p = track_edge(rise_ns_[i], es, c_);
+  if (p) width_ns_[i] = p->width.count();
+  return p;
+}
+
+std::optional<double> SensorTable::push_filter(size_t i, double v){
+  return median_push(std::span<double>(ring_).subspan(i * win_, win_), scratch_, pos_[i], fill_[i], v);
+}
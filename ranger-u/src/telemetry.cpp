@@ -1,14 +1,44 @@
 #include "telemetry.hpp"
-#include <sstream>
+#include <charconv>
 
-std::string to_json(const TelemetryFrame& tf){
-  std::ostringstream os;
-  os << "{";
-  os << "\"d\":[";
+static void append_float(std::string& out, float v){
+  char buf[32];
+  auto r = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::general, 6);
+  out.append(buf, r.ptr);
+}
+
+void append_int(std::string& out, long long v){
+  char buf[24];
+  auto r = std::to_chars(buf, buf + sizeof(buf), v);
+  out.append(buf, r.ptr);
+}
+
+void append_json(std::string& out, const TelemetryFrame& tf){
+  out += "{\"d\":[";
   for (size_t i=0;i<tf.dist_m.size();++i){
-    if (i) os << ",";
-    os << tf.dist_m[i];
+    if (i) out += ',';
+    append_float(out, tf.dist_m[i]);
   }
-  os << "]}";
-  return os.str();
+  out += "]}";
+}
+
+void append_csv_row(std::string& out, long long ts_ns, const TelemetryFrame& tf){
+  append_int(out, ts_ns);
+  for (float d : tf.dist_m){
+    out += ',';
+    append_float(out, d);
+  }
+  out += '\n';
+}
+
+std::string to_json(const TelemetryFrame& tf){
+  std::string s;
+  append_json(s, tf);
+  return s;
+}
+
+std::string to_csv_row(long long ts_ns, const TelemetryFrame& tf){
+  std::string s;
+  append_csv_row(s, ts_ns, tf);
+  return s;
 }
@@ -0,0 +1,79 @@
+#!/usr/bin/env bash
+set -euo pipefail
+# End-to-end latency benchmark: echo falling edge -> ranger-u -> ranger-can ->
+# ISO-TP recv() on vcan, per stage, for every RATES x SENSORS combination.
+#
+# Usage: ./scripts/bench_e2e.sh
+# Env:
+#   SOURCE=replay     # replay: echo_sim edges paced by ranger-u --replay-rt (no gpio-sim)
+#                     # gpio-sim: pulse_gen drives gpio-sim lines, ranger-u reads them via libgpiod
+#   RATES="20 50 100" # pulses per sensor per second
+#   SENSORS="1 5 8"   # sensor counts (gpio-sim: lines 0..N-1 of the chip); ranger-can
+#                     # runs with --allow-partial so that N < 5 still yields frames
+#   DUR_SEC=10        # per run
+#   FRAME_HZ=100      # ranger-u output frame rate (filt_out includes the wait for a frame)
+#   OUT=bench_e2e_out # <label>.json / <label>.txt per run, summary.txt
+#   IFACE=vcan0 TXID=0x701 RXID=0x700 BUILD=build-e2e
+
+ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+SOURCE="${SOURCE:-replay}"
+RATES="${RATES:-20 50 100}"
+SENSORS="${SENSORS:-1 5 8}"
+DUR="${DUR_SEC:-10}"
+FRAME_HZ="${FRAME_HZ:-100}"
+OUT="${OUT:-$ROOT/bench_e2e_out}"
+IFACE="${IFACE:-vcan0}"
+TXID="${TXID:-0x701}"
+RXID="${RXID:-0x700}"
+B="${BUILD:-$ROOT/build-e2e}"
+
+# vcan + isotp
+sudo modprobe vcan can-isotp || true
+ip link show "$IFACE" >/dev/null 2>&1 || { sudo ip link add dev "$IFACE" type vcan; sudo ip link set up "$IFACE"; }
+
+# optimized build, no sanitizers
+cmake -S "$ROOT" -B "$B" -DCMAKE_BUILD_TYPE=Release -DENABLE_ASAN=OFF >/dev/null
+cmake --build "$B" --target ranger-u ranger-can ranger-e2e-rx echo_sim pulse_gen -- -j
+
+if [ "$SOURCE" = "gpio-sim" ]; then
+  SIM_CHIP=$(gpiodetect | awk '/gpio-sim/ {print $1}' | head -n1)
+  [ -n "$SIM_CHIP" ] || { echo "[!] gpio-sim chip not found (run scripts/setup_sim.sh)"; exit 1; }
+fi
+
+mkdir -p "$OUT"
+: > "$OUT/summary.txt"
+printf "%-12s %8s %10s %10s %10s %10s\n" "run" "frames" "p50_us" "p99_us" "p999_us" "max_us" | tee -a "$OUT/summary.txt"
+
+for rate in $RATES; do
+  for n in $SENSORS; do
+    label="r${rate}_n${n}"
+    lines=$(seq -s, 0 $((n-1)))
+
+    "$B/bench/ranger-e2e-rx" --if "$IFACE" --tx "$RXID" --rx "$TXID" --duration $((DUR+5)) --idle 2 \
+      --label "$label" --json "$OUT/$label.json" > "$OUT/$label.txt" & RX_PID=$!
+    sleep 0.2
+
+    if [ "$SOURCE" = "gpio-sim" ]; then
+      map=$(seq -s, -f "%g:1.0" 0 $((n-1)))
+      sudo "$B/tools/pulse_gen/pulse_gen" "$map" --rate-hz "$rate" --duration "$DUR" 2>/dev/null & GEN_PID=$!
+      "$B/ranger-u/ranger-u" --chip "/dev/$SIM_CHIP" --lines "$lines" --duration "$DUR" \
+        --rate-hz "$FRAME_HZ" --with-ts --jsonl /dev/stdout \
+      | "$B/ranger-can/ranger-can" --if "$IFACE" --tx "$TXID" --rx "$RXID" --rate-hz 0 --with-ts --allow-partial
+      wait "$GEN_PID" || true
+    else
+      printf "sensors %d\nrate_hz %s\nduration %s\nseed 1\nsensor * const 1.0\nsensor * noise 0.003\n" \
+        "$n" "$rate" "$DUR" > "$OUT/$label.scn"
+      "$B/tools/echo_sim/echo_sim" "$OUT/$label.scn" 2>/dev/null \
+      | "$B/ranger-u/ranger-u" --replay - --replay-rt --lines "$lines" \
+          --rate-hz "$FRAME_HZ" --with-ts --jsonl /dev/stdout 2>/dev/null \
+      | "$B/ranger-can/ranger-can" --if "$IFACE" --tx "$TXID" --rx "$RXID" --rate-hz 0 --with-ts --allow-partial
+    fi
+
+    wait "$RX_PID" || echo "[warn] $label: no stamped frames received"
+    awk -v l="$label" '/^# .*frames=/ { split($3, f, "="); fr=f[2] }
+      $1=="edge_rx" { printf "%-12s %8s %10.1f %10.1f %10.1f %10.1f\n", l, fr, $3/1e3, $4/1e3, $5/1e3, $6/1e3 }' \
+      "$OUT/$label.txt" | tee -a "$OUT/summary.txt"
+  done
+done
+
+echo "[OK] per-stage tables and JSON in $OUT (summary: $OUT/summary.txt)"
@@ -0,0 +1,85 @@
+#!/usr/bin/env bash
+set -euo pipefail
+# ranger-u --loop classic vs --loop coro on the same echo_sim edges:
+#   1) real-time replay (--replay-rt): edge_recv / filter_encode / edge_out
+#      percentiles from --stats, so the executor's wakeup path is on the clock
+#   2) virtual-time replay: CPU ns per edge, best of 3
+#   3) --alloc-check (ranger-u-alloc-check): the coroutine path must stay
+#      allocation-free too
+# Runs without root or gpio-sim.
+#
+# Usage: ./scripts/bench_loop.sh
+# Env:
+#   BUILD=build-release
+#   SENSORS=8       # sensors in the generated scenario
+#   RATE_HZ=100     # ranger-u frame rate
+#   RT_SEC=20       # real-time replay length (seconds, per loop)
+#   CPU_SEC=300     # simulated seconds for the CPU runs
+#   OUT=bench_loop_out
+
+ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+B="${BUILD:-$ROOT/build-release}"
+SENSORS="${SENSORS:-8}"
+RATE_HZ="${RATE_HZ:-100}"
+RT_SEC="${RT_SEC:-20}"
+CPU_SEC="${CPU_SEC:-300}"
+OUT="${OUT:-$ROOT/bench_loop_out}"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+mkdir -p "$OUT"
+
+cmake -S "$ROOT" -B "$B" >/dev/null
+cmake --build "$B" --target ranger-u ranger-u-alloc-check echo_sim -- -j
+
+LINES="$(seq -s, 0 $((SENSORS - 1)))"
+scenario(){  # DURATION
+  printf "sensors %s\nrate_hz 100\nduration %s\nseed 7\nmode sim\nsensor * sine 1.5 1.0 0.2\nsensor * noise 0.01\nsensor * drop 0.02\n" \
+    "$SENSORS" "$1"
+}
+scenario "$RT_SEC" > "$WORK/rt.scn"
+scenario "$CPU_SEC" > "$WORK/cpu.scn"
+"$B/tools/echo_sim/echo_sim" "$WORK/rt.scn" > "$WORK/rt.txt"
+"$B/tools/echo_sim/echo_sim" "$WORK/cpu.scn" > "$WORK/cpu.txt"
+EDGES=$(grep -vc '^#' "$WORK/cpu.txt")
+
+# 1) latency, real time
+for loop in classic coro; do
+  echo "[i] $loop: ${RT_SEC} s real-time replay"
+  "$B/ranger-u/ranger-u" --loop "$loop" --replay "$WORK/rt.txt" --replay-rt --lines "$LINES" \
+    --rate-hz "$RATE_HZ" --jsonl /dev/null --stats "$OUT/stats_$loop.txt" >/dev/null 2>&1
+done
+
+# 2) CPU per edge, virtual time
+cpu_per_edge(){  # LOOP
+  local best="" t ns
+  for _ in 1 2 3; do
+    t=$( { TIMEFORMAT='%3U %3S'; time "$B/ranger-u/ranger-u" --loop "$1" --replay "$WORK/cpu.txt" \
+           --lines "$LINES" --rate-hz "$RATE_HZ" --jsonl /dev/null >/dev/null 2>&1; } 2>&1 )
+    ns=$(awk -v t="$t" -v n="$EDGES" 'BEGIN { split(t, a, " "); printf "%d", (a[1] + a[2]) * 1e9 / n }')
+    if [ -z "$best" ] || [ "$ns" -lt "$best" ]; then best=$ns; fi
+  done
+  echo "$best"
+}
+
+# 3) allocations after warmup
+allocs(){  # LOOP
+  "$B/ranger-u/ranger-u-alloc-check" --loop "$1" --replay "$WORK/rt.txt" --lines "$LINES" --rate-hz "$RATE_HZ" \
+    --with-ts --alloc-check --jsonl /dev/null --csv /dev/null 2>&1 >/dev/null \
+    | awk '/^# alloc-check/ { print $3 }'
+}
+
+us(){ awk -v s="$2" -v c="$3" '$1 == s { printf "%.1f", $c / 1000 }' "$1"; }
+{
+  echo "# ranger-u loops: $SENSORS sensors, frames at $RATE_HZ Hz"
+  printf "%-8s %10s %10s %10s %10s %10s %10s %12s %7s\n" loop \
+    recv_p50 recv_p99 enc_p50 enc_p99 out_p50 out_p99 cpu_ns/edge allocs
+  for loop in classic coro; do
+    s="$OUT/stats_$loop.txt"
+    printf "%-8s %10s %10s %10s %10s %10s %10s %12s %7s\n" "$loop" \
+      "$(us "$s" edge_recv 3)" "$(us "$s" edge_recv 4)" \
+      "$(us "$s" filter_encode 3)" "$(us "$s" filter_encode 4)" \
+      "$(us "$s" edge_out 3)" "$(us "$s" edge_out 4)" \
+      "$(cpu_per_edge "$loop")" "$(allocs "$loop")"
+  done
+  echo "(latencies in us from --replay-rt; cpu over $EDGES edges, best of 3)"
+} | tee "$OUT/summary.txt"
@@ -0,0 +1,67 @@
+#!/usr/bin/env bash
+set -euo pipefail
+# Sensor-count scaling: for each LINES count, create a gpio-sim bank of that
+# many lines, pulse all of them at RATE_HZ and measure each acquisition path
+# (u = ranger-u on libgpiod, k = ranger_k + ranger-u --kring).
+#
+# Usage: sudo ./scripts/bench_scaling.sh
+# Env:
+#   LINES="8 16 32 64 128 256"
+#   PATHS="u k"        # ranger_k takes at most 64 sensors (u64 frame mask); larger k runs are skipped
+#   RATE_HZ=20         # pulses per line per second
+#   DUR_SEC=10         # per run
+#   DIST_M=1.0         # echo distance on every line
+#   GEN_RT=0 GEN_CPU=-1  # pulse_gen SCHED_FIFO priority / CPU (keep it off the consumer's CPU)
+#   OUT=bench_scaling_out  # scaling.jsonl (one object per run) + summary.txt
+#   BUILD=build-release
+
+ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+LINES="${LINES:-8 16 32 64 128 256}"
+PATHS="${PATHS:-u k}"
+RATE="${RATE_HZ:-20}"
+DUR="${DUR_SEC:-10}"
+DIST="${DIST_M:-1.0}"
+GEN_RT="${GEN_RT:-0}"
+GEN_CPU="${GEN_CPU:--1}"
+OUT="${OUT:-$ROOT/bench_scaling_out}"
+B="${BUILD:-$ROOT/build-release}"
+K_MAX=64
+
+[ "$(id -u)" = 0 ] || { echo "[!] run as root (configfs, debugfs, insmod)"; exit 1; }
+
+modprobe configfs || true
+mount | grep -q " on /sys/kernel/config type configfs " || mount -t configfs none /sys/kernel/config
+mount | grep -q " on /sys/kernel/debug type debugfs " || mount -t debugfs none /sys/kernel/debug
+modprobe gpio-sim
+
+cmake -S "$ROOT" -B "$B" -DCMAKE_BUILD_TYPE=Release -DENABLE_ASAN=OFF >/dev/null
+cmake --build "$B" --target ranger-u pulse_gen ranger-scale -- -j
+case " $PATHS " in *" k "*) make -C "$ROOT/ranger-k" >/dev/null ;; esac
+
+SCALE="$B/bench/ranger-scale"
+trap 'rmmod ranger_k 2>/dev/null || true; "$SCALE" unbank >/dev/null 2>&1 || true' EXIT
+
+mkdir -p "$OUT"
+: > "$OUT/scaling.jsonl"
+header=--header
+for n in $LINES; do
+  chip=$("$SCALE" bank --lines "$n")
+  echo "[i] $n lines on $chip" >&2
+  for p in $PATHS; do
+    if [ "$p" = k ]; then
+      if [ "$n" -gt "$K_MAX" ]; then
+        echo "[i] k: skipping $n lines (ranger_k MAX_SENSORS=$K_MAX)" >&2
+        continue
+      fi
+      rmmod ranger_k 2>/dev/null || true
+      insmod "$ROOT/ranger-k/ranger_k.ko" sim_chip=ranger-scale sim_lines="$n" ${RANGER_K_ARGS:-}
+    fi
+    "$SCALE" run --path "$p" --lines "$n" --rate-hz "$RATE" --duration "$DUR" --dist "$DIST" \
+      --gen-rt "$GEN_RT" --gen-cpu "$GEN_CPU" --label "${p}_n${n}_r${RATE}" --json "$OUT/scaling.jsonl" $header
+    header=
+    if [ "$p" = k ]; then rmmod ranger_k; fi
+  done
+  "$SCALE" unbank
+done | tee "$OUT/summary.txt"
+
+echo "[OK] $OUT/summary.txt, $OUT/scaling.jsonl"
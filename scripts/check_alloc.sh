@@ -0,0 +1,38 @@
+#!/usr/bin/env bash
+set -euo pipefail
+# Zero-allocation check: replay echo_sim workloads through ranger-u-alloc-check
+# (ranger-u with a counting operator new, armed after 1 s of frames) and fail
+# if the edge -> sink path allocated, with both --loop classic and --loop coro.
+# Runs without root or gpio-sim.
+#
+# Usage: ./scripts/check_alloc.sh
+# Env: BUILD=build-release
+
+ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+B="${BUILD:-$ROOT/build-release}"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+cmake -S "$ROOT" -B "$B" >/dev/null
+cmake --build "$B" --target ranger-u-alloc-check echo_sim -- -j
+
+printf "sensors 16\nrate_hz 100\nduration 30\nseed 5\nmode sim\nsensor * sine 1.5 1.2 0.3\nsensor * noise 0.01\nsensor * drop 0.05\nsensor 3 spike 0.1 4.0\n" \
+  > "$WORK/dense.scn"
+
+rc=0
+check(){  # NAME SCENARIO LINES
+  "$B/tools/echo_sim/echo_sim" "$2" > "$WORK/edges.txt" 2>/dev/null
+  for loop in classic coro; do
+    if "$B/ranger-u/ranger-u-alloc-check" --loop "$loop" --replay "$WORK/edges.txt" --lines "$3" --rate-hz 50 \
+         --with-ts --alloc-check --jsonl "$WORK/out.jsonl" --csv "$WORK/out.csv" --stats "$WORK/stats.txt" \
+         >/dev/null 2>"$WORK/err.txt"; then
+      echo "[OK]   $1/$loop: $(grep '^# alloc-check' "$WORK/err.txt")"
+    else
+      echo "[FAIL] $1/$loop: $(grep '^# alloc-check' "$WORK/err.txt" || tail -n 3 "$WORK/err.txt")"
+      rc=1
+    fi
+  done
+}
+check approach "$ROOT/tools/echo_sim/scenarios/approach.scn" 0,1,2,3,4
+check dense16  "$WORK/dense.scn" "$(seq -s, 0 15)"
+exit $rc
@@ -21,7 +21,7 @@ cmake -S "$ROOT" -B "$ROOT/build"
 cmake --build "$ROOT/build" -- -j
 
 # 5) start generator (root) in background
-sudo DEBUG=${DEBUG:-0} "$SCRIPT_DIR/pulse_gen_multi.sh" "$MAP" & GEN_PID=$!
+sudo "$ROOT/build/tools/pulse_gen/pulse_gen" "$MAP" --rate-hz "${GEN_HZ:-12.5}" & GEN_PID=$!
 trap 'kill $GEN_PID 2>/dev/null || true' EXIT
 echo "[+] pulse generator PID=$GEN_PID"
 
@@ -0,0 +1,78 @@
+#!/usr/bin/env bash
+set -euo pipefail
+# Profile-guided build of ranger-u / ranger-can, trained on the replay workload,
+# then CPU per edge for the default (ASan), Release+LTO and PGO builds.
+#
+# Usage: ./scripts/pgo_build.sh
+# Env:
+#   TRAIN_SEC=120   # simulated seconds of echo_sim edges per training scenario
+#   MARCH=          # RANGER_MARCH for the Release and PGO builds (e.g. native)
+#   IFACE=vcan0     # if the interface exists, ranger-can is trained on it too
+#   SKIP_COMPARE=0  # 1 = only build build-pgo
+
+ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+TRAIN_SEC="${TRAIN_SEC:-120}"
+MARCH="${MARCH:-}"
+IFACE="${IFACE:-vcan0}"
+PGO="$ROOT/build-pgo"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+TARGETS="ranger-u ranger-can echo_sim"
+
+# 1) instrumented build; GEN and USE share build-pgo so object paths (profile names) match
+rm -rf "$PGO/pgo-profiles"
+cmake -S "$ROOT" -B "$PGO" -DCMAKE_BUILD_TYPE=Release -DENABLE_ASAN=OFF \
+  -DRANGER_MARCH="$MARCH" -DRANGER_PGO=GEN >/dev/null
+cmake --build "$PGO" --target $TARGETS -- -j
+
+# 2) training: the shipped scenario plus dense many-sensor runs, virtual-time replay
+"$PGO/tools/echo_sim/echo_sim" "$ROOT/tools/echo_sim/scenarios/approach.scn" --duration "$TRAIN_SEC" > "$WORK/approach.txt"
+printf "sensors 8\nrate_hz 100\nduration %s\nseed 3\nmode sim\nsensor * sine 1.5 1.0 0.2\nsensor * noise 0.01\nsensor * drop 0.01\n" \
+  "$TRAIN_SEC" > "$WORK/dense.scn"
+"$PGO/tools/echo_sim/echo_sim" "$WORK/dense.scn" > "$WORK/dense.txt"
+
+"$PGO/ranger-u/ranger-u" --replay "$WORK/approach.txt" --lines 0,1,2,3,4 --jsonl /dev/null --csv /dev/null 2>/dev/null
+"$PGO/ranger-u/ranger-u" --replay "$WORK/dense.txt" --lines 0,1,2,3,4,5,6,7 --jsonl /dev/null 2>/dev/null
+if ip link show "$IFACE" >/dev/null 2>&1; then
+  "$PGO/ranger-u/ranger-u" --replay "$WORK/approach.txt" --lines 0,1,2,3,4 --jsonl /dev/stdout 2>/dev/null \
+  | "$PGO/ranger-can/ranger-can" --if "$IFACE" --rate-hz 0 >/dev/null 2>&1 || true
+else
+  echo "[i] $IFACE not found: ranger-can keeps its non-PGO optimization"
+fi
+
+# clang writes .profraw files that have to be merged first
+if ls "$PGO/pgo-profiles"/*.profraw >/dev/null 2>&1; then
+  llvm-profdata merge -o "$PGO/pgo-profiles/default.profdata" "$PGO/pgo-profiles"/*.profraw
+fi
+
+# 3) optimized rebuild with the profiles
+cmake -S "$ROOT" -B "$PGO" -DRANGER_PGO=USE >/dev/null
+cmake --build "$PGO" --target $TARGETS -- -j
+echo "[OK] PGO binaries in $PGO"
+
+[ "${SKIP_COMPARE:-0}" = 1 ] && exit 0
+
+# 4) CPU per edge: ranger-u user+sys time over the dense replay, same input for all builds
+cmake -S "$ROOT" -B "$ROOT/build-asan" -DCMAKE_BUILD_TYPE= -DENABLE_ASAN=ON -DRANGER_LTO=OFF >/dev/null
+cmake -S "$ROOT" -B "$ROOT/build-release" -DCMAKE_BUILD_TYPE=Release -DENABLE_ASAN=OFF -DRANGER_MARCH="$MARCH" >/dev/null
+cmake --build "$ROOT/build-asan" --target ranger-u -- -j
+cmake --build "$ROOT/build-release" --target ranger-u -- -j
+
+EDGES=$(grep -vc '^#' "$WORK/dense.txt")
+cpu_per_edge(){
+  local best="" t ns
+  for _ in 1 2 3; do
+    t=$( { TIMEFORMAT='%3U %3S'; time "$1" --replay "$WORK/dense.txt" --lines 0,1,2,3,4,5,6,7 \
+           --jsonl /dev/null >/dev/null 2>&1; } 2>&1 )
+    ns=$(awk -v t="$t" -v n="$EDGES" 'BEGIN { split(t, a, " "); printf "%d", (a[1] + a[2]) * 1e9 / n }')
+    if [ -z "$best" ] || [ "$ns" -lt "$best" ]; then best=$ns; fi
+  done
+  echo "$best"
+}
+
+printf "%-30s %12s\n" "build (ranger-u --replay)" "cpu_ns/edge"
+printf "%-30s %12s\n" "default before (ASan+UBSan)" "$(cpu_per_edge "$ROOT/build-asan/ranger-u/ranger-u")"
+printf "%-30s %12s\n" "Release + LTO" "$(cpu_per_edge "$ROOT/build-release/ranger-u/ranger-u")"
+printf "%-30s %12s\n" "Release + LTO + PGO" "$(cpu_per_edge "$PGO/ranger-u/ranger-u")"
+echo "($EDGES edges, best of 3)"
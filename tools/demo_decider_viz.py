@@ -3,6 +3,7 @@ import argparse
 import curses
 import time
 import os
+import select
 
 def parse_csv_line(s):
     # expects "m.mmm,m.mmm,m.mmm,m.mmm,m.mmm"
@@ -40,12 +41,20 @@ def decide(vals, near=0.40, far=0.80):
 
     return "FORWARD"
 
+def open_source(path):
+    """Open the debugfs file once; ranger_k wakes poll() on new data."""
+    fd = os.open(path, os.O_RDONLY)
+    p = select.poll()
+    p.register(fd, select.POLLIN | select.POLLPRI)
+    return fd, p
+
 def draw(stdscr, src_path, hz=10):
     curses.curs_set(0)
     stdscr.nodelay(True)
     period = 1.0 / max(1, hz)
     last_vals = None
     err = ""
+    src = None  # (fd, poller)
 
     title = "Ultrasonic Ranger — Live TUI (debugfs)"
     help1 = "q: quit    r: reload file    +/-: rate    space: clear error"
@@ -63,30 +72,37 @@ def draw(stdscr, src_path, hz=10):
             elif ch == ord('-'):
                 period = min(1.0, period * 1.25)
             elif ch == ord('r'):
-                # just re-open next iteration
-                pass
+                # re-open below
+                if src:
+                    os.close(src[0])
+                src = None
             elif ch == ord(' '):
                 err = ""
         except:
             pass
 
-        # read sysfs
+        # read sysfs: block in poll() up to one period, parse only on new data
         vals = None
         try:
-            with open(src_path, "r") as f:
-                line = f.readline()
-            parsed = parse_csv_line(line)
-            if parsed is not None:
-                vals = parsed
-                last_vals = vals
-            else:
-                err = "Malformed CSV from sysfs"
+            if src is None:
+                src = open_source(src_path)
+            if src[1].poll(int(period * 1000)):
+                line = os.pread(src[0], 512, 0).decode(errors="replace")
+                parsed = parse_csv_line(line)
+                if parsed is not None:
+                    vals = parsed
+                    last_vals = vals
+                else:
+                    err = "Malformed CSV from sysfs"
         except PermissionError:
             err = "Permission denied. Try sudo or check file mode."
         except FileNotFoundError:
             err = f"Source not found: {src_path}"
         except Exception as e:
             err = f"Read error: {e}"
+            if src:
+                os.close(src[0])
+            src = None
 
         # pick what to show
         show = last_vals if vals is None else vals
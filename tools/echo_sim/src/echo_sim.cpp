@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * echo_sim: scenario-driven HC-SR04 echo simulator
+ * - Reads a scenario file (format below) and writes the echo edges it
+ *   implies as "ts_ns sensor R|F" lines, time-ordered, as fast as it can.
+ * - The edge stream feeds ranger-u --replay directly (virtual time, no
+ *   hardware), or pulse_gen --edges to play it on gpio-sim lines in real
+ *   time for ranger_k / ranger-u on libgpiod.
+ * - --truth writes "ts_ns sensor dist_m" per cycle (the noiseless distance)
+ *   so filter and decider output can be scored against it.
+ *
+ * Scenario file, one directive per line, '#' comments:
+ *   sensors N            rate_hz HZ (per sensor)   duration S   seed N
+ *   mode rr|sim          (stagger sensors across the period, or fire together)
+ *   sound M_PER_S        max_range M (farther = no echo)
+ *   sensor I|* const D
+ *   sensor I|* ramp T0 D0 T1 D1                 (held outside [T0,T1])
+ *   sensor I|* sine MEAN AMP HZ
+ *   sensor I|* points T D T D ...               (linear in between)
+ *   sensor I|* noise SIGMA_M                    (Gaussian)
+ *   sensor I|* spike P [SCALE]                  (multipath: distance * SCALE, default 2)
+ *   sensor I|* drop P                           (no echo)
+ *   sensor I|* xtalk P [FROM]                   (echo of sensor FROM, default I+1)
+ */
+
+enum class Traj { Const, Ramp, Sine, Points };
+
+struct SensorScn {
+  Traj traj = Traj::Const;
+  std::vector<double> p = {1.0};  // trajectory parameters
+  double noise = 0.0;
+  double spike_p = 0.0, spike_scale = 2.0;
+  double drop_p = 0.0;
+  double xtalk_p = 0.0;
+  int xtalk_from = -1;
+};
+
+struct Scenario {
+  int sensors = 5;
+  double rate_hz = 20.0;
+  double duration_s = 10.0;
+  uint64_t seed = 1;
+  bool sim = false;
+  double sound = 343.0;
+  double max_range = 4.0;
+  std::vector<SensorScn> s;
+};
+
+struct Args {
+  std::string scenario;
+  std::string out = "-";
+  std::string truth;
+  double duration_s = -1;  // <0 = scenario's
+  long long seed = -1;     // <0 = scenario's
+};
+
+static void usage(const char* prog){
+  std::cerr << "Usage: " << prog << " SCENARIO [-o edges.txt|-] [--truth truth.txt]\n"
+            << "       [--duration S] [--seed N]\n";
+}
+
+static Args parse_args(int argc, char** argv){
+  Args a;
+  for (int i=1;i<argc;i++){
+    std::string k = argv[i];
+    auto need = [&](const char* name){ if (i+1>=argc) { std::cerr<<"Missing value for "<<name<<"\n"; std::exit(2);} return std::string(argv[++i]); };
+    if (k=="-o") a.out = need("-o");
+    else if (k=="--truth") a.truth = need("--truth");
+    else if (k=="--duration") a.duration_s = std::stod(need("--duration"));
+    else if (k=="--seed") a.seed = std::stoll(need("--seed"));
+    else if (k=="-h" || k=="--help"){ usage(argv[0]); std::exit(0); }
+    else if (!k.empty() && k[0] != '-' && a.scenario.empty()) a.scenario = k;
+    else { usage(argv[0]); std::exit(2); }
+  }
+  if (a.scenario.empty()) { usage(argv[0]); std::exit(2); }
+  return a;
+}
+
+[[noreturn]] static void fail(const std::string& where, const std::string& what){
+  std::cerr << "[!] " << where << ": " << what << "\n";
+  std::exit(1);
+}
+
+static Scenario load_scenario(const std::string& path){
+  std::ifstream in(path);
+  if (!in) fail(path, "cannot open");
+  Scenario sc;
+  // Sensor directives may precede "sensors N": keep them and apply after
+  std::vector<std::pair<std::string, std::vector<std::string>>> per;
+  std::string line;
+  int lineno = 0;
+  while (std::getline(in, line)){
+    lineno++;
+    auto h = line.find('#');
+    if (h != std::string::npos) line.resize(h);
+    std::istringstream ss(line);
+    std::vector<std::string> tok;
+    for (std::string t; ss >> t;) tok.push_back(t);
+    if (tok.empty()) continue;
+    std::string where = path + ":" + std::to_string(lineno);
+    auto num = [&](size_t i){
+      if (i >= tok.size()) fail(where, "missing value");
+      try { return std::stod(tok[i]); } catch (...) { fail(where, "bad number '" + tok[i] + "'"); }
+    };
+    const std::string& k = tok[0];
+    if (k=="sensors") sc.sensors = (int)num(1);
+    else if (k=="rate_hz") sc.rate_hz = num(1);
+    else if (k=="duration") sc.duration_s = num(1);
+    else if (k=="seed") sc.seed = (uint64_t)num(1);
+    else if (k=="sound") sc.sound = num(1);
+    else if (k=="max_range") sc.max_range = num(1);
+    else if (k=="mode" && tok.size() > 1 && (tok[1]=="rr" || tok[1]=="sim")) sc.sim = tok[1]=="sim";
+    else if (k=="sensor" && tok.size() > 2) per.push_back({where, tok});
+    else fail(where, "unknown directive '" + k + "'");
+  }
+  if (sc.sensors < 1 || sc.rate_hz <= 0 || sc.sound <= 0) fail(path, "sensors, rate_hz and sound must be > 0");
+  sc.s.resize(sc.sensors);
+
+  for (auto& [where, tok] : per){
+    std::vector<double> v;
+    for (size_t i = 3; i < tok.size(); i++){
+      try { v.push_back(std::stod(tok[i])); } catch (...) { fail(where, "bad number '" + tok[i] + "'"); }
+    }
+    auto arg = [&](size_t i, double def){ return i < v.size() ? v[i] : def; };
+    int first = 0, last = sc.sensors - 1;
+    if (tok[1] != "*"){
+      first = last = std::stoi(tok[1]);
+      if (first < 0 || first >= sc.sensors) fail(where, "no sensor " + tok[1]);
+    }
+    const std::string& kind = tok[2];
+    for (int i = first; i <= last; i++){
+      SensorScn& s = sc.s[i];
+      if (kind=="const" && v.size()==1) { s.traj = Traj::Const; s.p = v; }
+      else if (kind=="ramp" && v.size()==4) { s.traj = Traj::Ramp; s.p = v; }
+      else if (kind=="sine" && v.size()==3) { s.traj = Traj::Sine; s.p = v; }
+      else if (kind=="points" && v.size()>=2 && v.size()%2==0) { s.traj = Traj::Points; s.p = v; }
+      else if (kind=="noise" && v.size()==1) s.noise = v[0];
+      else if (kind=="spike" && !v.empty()) { s.spike_p = v[0]; s.spike_scale = arg(1, 2.0); }
+      else if (kind=="drop" && v.size()==1) s.drop_p = v[0];
+      else if (kind=="xtalk" && !v.empty()) {
+        s.xtalk_p = v[0];
+        s.xtalk_from = (int)arg(1, (i + 1) % sc.sensors);
+        if (s.xtalk_from < 0 || s.xtalk_from >= sc.sensors) fail(where, "xtalk from a missing sensor");
+      }
+      else fail(where, "bad '" + kind + "' directive");
+    }
+  }
+  return sc;
+}
+
+static double lerp(double t, double t0, double d0, double t1, double d1){
+  if (t <= t0) return d0;
+  if (t >= t1 || t1 <= t0) return d1;
+  return d0 + (t - t0) / (t1 - t0) * (d1 - d0);
+}
+
+// Noiseless distance of sensor s at time t
+static double true_dist(const SensorScn& s, double t){
+  const auto& p = s.p;
+  switch (s.traj){
+    case Traj::Const: return p[0];
+    case Traj::Ramp: return lerp(t, p[0], p[1], p[2], p[3]);
+    case Traj::Sine: return p[0] + p[1] * std::sin(2 * M_PI * p[2] * t);
+    case Traj::Points: {
+      if (t <= p[0]) return p[1];
+      for (size_t i = 2; i < p.size(); i += 2)
+        if (t < p[i]) return lerp(t, p[i-2], p[i-1], p[i], p[i+1]);
+      return p[p.size()-1];
+    }
+  }
+  return 0.0;
+}
+
+struct EdgeOut { int64_t ts; int sensor; char kind; };
+
+int main(int argc, char** argv){
+  auto args = parse_args(argc, argv);
+  Scenario sc = load_scenario(args.scenario);
+  if (args.duration_s >= 0) sc.duration_s = args.duration_s;
+  if (args.seed >= 0) sc.seed = (uint64_t)args.seed;
+
+  FILE* out = args.out == "-" ? stdout : std::fopen(args.out.c_str(), "w");
+  if (!out) fail(args.out, "cannot open");
+  FILE* truth = nullptr;
+  if (!args.truth.empty() && !(truth = std::fopen(args.truth.c_str(), "w"))) fail(args.truth, "cannot open");
+
+  std::mt19937_64 rng(sc.seed);
+  std::uniform_real_distribution<double> uni(0.0, 1.0);
+  std::normal_distribution<double> gauss(0.0, 1.0);
+
+  const int n = sc.sensors;
+  const int64_t period = (int64_t)std::llround(1e9 / sc.rate_hz);
+  const int64_t max_width = period - std::min<int64_t>(period / 10, 100000);
+  const int64_t cycles = (int64_t)std::floor(sc.duration_s * sc.rate_hz);
+  uint64_t pulses = 0, drops = 0, spikes = 0, xtalks = 0, clamped = 0;
+
+  // Edges of cycle k lie in [k*period, (k+2)*period): sort and flush
+  // everything before the next cycle's start as we go.
+  std::vector<EdgeOut> pending;
+  auto flush = [&](int64_t before){
+    std::sort(pending.begin(), pending.end(), [](const EdgeOut& a, const EdgeOut& b){
+      return a.ts != b.ts ? a.ts < b.ts : a.sensor < b.sensor;
+    });
+    size_t i = 0;
+    for (; i < pending.size() && pending[i].ts < before; i++)
+      std::fprintf(out, "%lld %d %c\n", (long long)pending[i].ts, pending[i].sensor, pending[i].kind);
+    pending.erase(pending.begin(), pending.begin() + i);
+  };
+
+  for (int64_t k = 0; k < cycles; k++){
+    for (int i = 0; i < n; i++){
+      const SensorScn& s = sc.s[i];
+      int64_t t0 = k * period + (sc.sim ? 0 : period * i / n);
+      double t = t0 * 1e-9;
+      double d = true_dist(s, t);
+      if (truth) std::fprintf(truth, "%lld %d %.6f\n", (long long)t0, i, d);
+
+      if (uni(rng) < s.drop_p) { drops++; continue; }
+      if (s.xtalk_from >= 0 && uni(rng) < s.xtalk_p) {
+        d = true_dist(sc.s[s.xtalk_from], t);
+        xtalks++;
+      } else if (uni(rng) < s.spike_p) {
+        d *= s.spike_scale;
+        spikes++;
+      }
+      if (s.noise > 0) d += s.noise * gauss(rng);
+      if (d <= 0 || d > sc.max_range) { drops++; continue; }
+
+      int64_t width = (int64_t)std::llround(2.0 * d / sc.sound * 1e9);
+      if (width > max_width) { width = max_width; clamped++; }
+      pending.push_back({t0, i, 'R'});
+      pending.push_back({t0 + width, i, 'F'});
+      pulses++;
+    }
+    flush((k + 1) * period);
+  }
+  flush(INT64_MAX);
+
+  if (out != stdout) std::fclose(out);
+  if (truth) std::fclose(truth);
+  std::cerr << "[i] " << n << " sensors, " << cycles << " cycles: pulses=" << pulses << " drops=" << drops
+            << " spikes=" << spikes << " xtalk=" << xtalks << " clamped=" << clamped << "\n";
+  return 0;
+}
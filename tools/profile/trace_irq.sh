@@ -1,8 +1,14 @@
 #!/usr/bin/env bash
 set -euo pipefail
-# Trace IRQ and scheduling for ranger_k.
+# Trace ranger_k edge/measurement events together with IRQ and scheduling.
+# ranger_k:* edge events carry the hard-IRQ timestamp (CLOCK_MONOTONIC); the
+# mono trace clock makes it directly comparable with the record timestamps.
 DUR="${1:-5}"
-EVENTS="${EVENTS:-irq:*,sched:*}"
+EVENTS="${EVENTS:-ranger_k irq sched:sched_wakeup sched:sched_switch}"
 
-sudo trace-cmd record -e "$EVENTS" -d "${DUR}s"
+ARGS=()
+for e in $EVENTS; do ARGS+=(-e "$e"); done
+
+sudo trace-cmd record -C mono "${ARGS[@]}" sleep "${DUR}"
 echo "[+] trace.dat saved. View with: trace-cmd report | less"
+echo "    per-sensor widths: trace-cmd report | grep ranger_k_measure"
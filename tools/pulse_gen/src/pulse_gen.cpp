@@ -0,0 +1,314 @@
+#include <fcntl.h>
+#include <glob.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * pulse_gen: HC-SR04-like echo generator for gpio-sim
+ * - Same "line:distance,..." map as scripts/pulse_gen_multi.sh; a distance
+ *   may also be "@file", a script of "t_s dist_m" points (linear in between,
+ *   held after the last one, or repeated with --loop).
+ * - Every line's sim_gpioN/pull file is opened once and rewritten with
+ *   pwrite(); edges are scheduled on CLOCK_MONOTONIC with absolute
+ *   clock_nanosleep(), so widths are us-accurate and rates reach kHz.
+ * - Each line pulses once per 1/rate period; lines are staggered evenly
+ *   across the period (--sim: all rise together).
+ * - --log writes every edge as "ts_ns line R|F" (CLOCK_MONOTONIC, the
+ *   ranger_k timestamp clock) for comparing against what was measured.
+ * - --edges plays such an edge stream instead (e.g. tools/echo_sim output,
+ *   "-" = stdin) on sim_gpio<line_base + sensor>, timed from its first edge.
+ */
+
+static volatile std::sig_atomic_t g_stop = 0;
+static void on_sigint(int){ g_stop = 1; }
+
+static constexpr double kSound = 343.0;  // m/s, same as pulse_gen_multi.sh
+static constexpr int64_t kNs = 1000000000LL;
+
+struct Point { double t_s; double dist_m; };
+
+struct Line {
+  int id = 0;
+  std::vector<Point> script;  // one point = constant distance
+  int fd = -1;
+  bool high = false;
+  int64_t rise = 0;           // current/next rising edge (abs ns)
+  int64_t next = 0;           // next edge (abs ns)
+  uint64_t pulses = 0, clamped = 0, errors = 0;
+};
+
+struct Args {
+  std::string map = "0:1.0,1:1.6,2:0.8,3:2.2,4:0.35";
+  std::string chip_dir;       // empty = first gpio-sim.0 chip
+  double rate_hz = 12.5;      // pulses per line per second (80 ms frames)
+  double duration_s = 0.0;    // 0 = until SIGINT
+  bool sim = false;
+  bool loop = false;
+  int rt_prio = 0;            // SCHED_FIFO priority, 0 = leave as is
+  int cpu = -1;
+  int spin_us = 0;            // wake this early and spin to the edge
+  std::string log;
+  std::string edges;          // play this edge file instead of MAP
+  int line_base = 0;
+};
+
+static void usage(const char* prog){
+  std::cerr << "Usage: " << prog << " [MAP] [--rate-hz 12.5] [--sim] [--loop] [--duration S]\n"
+            << "       [--chip DIR] [--rt PRIO] [--cpu N] [--spin-us N] [--log FILE]\n"
+            << "       " << prog << " --edges FILE|- [--line-base N] [--chip DIR] [--rt PRIO] [--cpu N] [--spin-us N]\n"
+            << "MAP: \"line:dist_m,...\" where dist_m is a number or @file (\"t_s dist_m\" lines)\n"
+            << "Default MAP: 0:1.0,1:1.6,2:0.8,3:2.2,4:0.35\n";
+}
+
+static Args parse_args(int argc, char** argv){
+  Args a;
+  for (int i=1;i<argc;i++){
+    std::string k = argv[i];
+    auto need = [&](const char* name){ if (i+1>=argc) { std::cerr<<"Missing value for "<<name<<"\n"; std::exit(2);} return std::string(argv[++i]); };
+    if (k=="--rate-hz") a.rate_hz = std::stod(need("--rate-hz"));
+    else if (k=="--duration") a.duration_s = std::stod(need("--duration"));
+    else if (k=="--chip") a.chip_dir = need("--chip");
+    else if (k=="--sim") a.sim = true;
+    else if (k=="--loop") a.loop = true;
+    else if (k=="--rt") a.rt_prio = std::stoi(need("--rt"));
+    else if (k=="--cpu") a.cpu = std::stoi(need("--cpu"));
+    else if (k=="--spin-us") a.spin_us = std::stoi(need("--spin-us"));
+    else if (k=="--log") a.log = need("--log");
+    else if (k=="--edges") a.edges = need("--edges");
+    else if (k=="--line-base") a.line_base = std::stoi(need("--line-base"));
+    else if (k=="-h" || k=="--help"){ usage(argv[0]); std::exit(0); }
+    else if (!k.empty() && k[0] != '-') a.map = k;
+    else { usage(argv[0]); std::exit(2); }
+  }
+  if (a.rate_hz <= 0) { std::cerr << "--rate-hz must be > 0\n"; std::exit(2); }
+  return a;
+}
+
+static std::vector<Point> load_script(const std::string& path){
+  std::ifstream in(path);
+  if (!in) { std::cerr << "[!] cannot open script " << path << "\n"; std::exit(1); }
+  std::vector<Point> pts;
+  std::string line;
+  while (std::getline(in, line)){
+    auto h = line.find('#');
+    if (h != std::string::npos) line.resize(h);
+    std::istringstream ss(line);
+    Point p{};
+    if (!(ss >> p.t_s >> p.dist_m)) continue;
+    if (!pts.empty() && p.t_s < pts.back().t_s) {
+      std::cerr << "[!] " << path << ": times must not decrease\n"; std::exit(1);
+    }
+    pts.push_back(p);
+  }
+  if (pts.empty()) { std::cerr << "[!] " << path << ": no \"t_s dist_m\" points\n"; std::exit(1); }
+  return pts;
+}
+
+static std::vector<Line> parse_map(const std::string& map){
+  std::vector<Line> lines;
+  std::stringstream ss(map);
+  std::string item;
+  while (std::getline(ss, item, ',')){
+    auto c = item.find(':');
+    if (c == std::string::npos) continue;
+    Line l;
+    l.id = std::stoi(item.substr(0, c));
+    std::string d = item.substr(c+1);
+    if (!d.empty() && d[0] == '@') l.script = load_script(d.substr(1));
+    else l.script.push_back({0.0, std::stod(d)});
+    lines.push_back(std::move(l));
+  }
+  return lines;
+}
+
+static double dist_at(const std::vector<Point>& s, double t, bool loop){
+  if (s.size() == 1) return s[0].dist_m;
+  double end = s.back().t_s;
+  if (loop && end > 0) t = std::fmod(t, end);
+  if (t <= s.front().t_s) return s.front().dist_m;
+  if (t >= end) return s.back().dist_m;
+  auto it = std::upper_bound(s.begin(), s.end(), t, [](double v, const Point& p){ return v < p.t_s; });
+  const Point& b = *it;
+  const Point& a = *(it-1);
+  double f = (b.t_s > a.t_s) ? (t - a.t_s) / (b.t_s - a.t_s) : 1.0;
+  return a.dist_m + f * (b.dist_m - a.dist_m);
+}
+
+static std::string find_chip_dir(){
+  glob_t g{};
+  std::string dir;
+  if (glob("/sys/devices/platform/gpio-sim.0/gpiochip*", 0, nullptr, &g) == 0 && g.gl_pathc > 0)
+    dir = g.gl_pathv[0];
+  globfree(&g);
+  return dir;
+}
+
+static int open_pull(const std::string& chip, int id){
+  std::string path = chip + "/sim_gpio" + std::to_string(id) + "/pull";
+  int fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+  if (fd < 0) { std::cerr << "[!] open " << path << ": " << std::strerror(errno) << "\n"; std::exit(1); }
+  return fd;
+}
+
+static int64_t now_ns(){
+  timespec ts{};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * kNs + ts.tv_nsec;
+}
+
+static void sleep_until(int64_t t, int spin_us){
+  int64_t wake = t - (int64_t)spin_us * 1000;
+  timespec ts{ (time_t)(wake / kNs), (long)(wake % kNs) };
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR && !g_stop) {}
+  if (spin_us > 0)
+    while (now_ns() < t) {}
+}
+
+static void set_realtime(const Args& args){
+  if (args.cpu >= 0){
+    cpu_set_t set; CPU_ZERO(&set); CPU_SET(args.cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) std::perror("sched_setaffinity");
+  }
+  if (args.rt_prio > 0){
+    sched_param sp{}; sp.sched_priority = args.rt_prio;
+    if (sched_setscheduler(0, SCHED_FIFO, &sp) != 0) std::perror("sched_setscheduler");
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) std::perror("mlockall");
+  }
+}
+
+// --edges: "ts_ns sensor R|F" lines, relative to the first one
+static int play_edges(const Args& args, const std::string& chip){
+  FILE* in = args.edges == "-" ? stdin : std::fopen(args.edges.c_str(), "r");
+  if (!in) { std::cerr << "[!] open " << args.edges << ": " << std::strerror(errno) << "\n"; return 1; }
+  std::vector<int> fds;
+  int64_t first = -1, start = 0, late_max = 0;
+  uint64_t edges = 0, errors = 0, late_100us = 0;
+  char buf[128];
+  while (!g_stop && std::fgets(buf, sizeof(buf), in)){
+    long long ts; int sensor; char kind;
+    if (std::sscanf(buf, "%lld %d %c", &ts, &sensor, &kind) != 3 || sensor < 0 || (kind != 'R' && kind != 'F'))
+      continue;
+    if ((size_t)sensor >= fds.size()) fds.resize(sensor + 1, -1);
+    if (fds[sensor] < 0) fds[sensor] = open_pull(chip, args.line_base + sensor);
+    if (first < 0) { first = ts; start = now_ns() + 10000000; }
+
+    int64_t at = start + (ts - first);
+    sleep_until(at, args.spin_us);
+    if (g_stop) break;
+    int64_t late = now_ns() - at;
+    late_max = std::max(late_max, late);
+    late_100us += late > 100000;
+    if (kind == 'R' ? ::pwrite(fds[sensor], "pull-up", 7, 0) < 0 : ::pwrite(fds[sensor], "pull-down", 9, 0) < 0)
+      errors++;
+    edges++;
+  }
+  for (int fd : fds){
+    if (fd < 0) continue;
+    ::pwrite(fd, "pull-down", 9, 0);
+    ::close(fd);
+  }
+  if (in != stdin) std::fclose(in);
+  std::cerr << "[i] edges=" << edges << " write_errors=" << errors << " late_max_us=" << late_max / 1e3
+            << " late_gt_100us=" << late_100us << "\n";
+  return 0;
+}
+
+int main(int argc, char** argv){
+  auto args = parse_args(argc, argv);
+  std::signal(SIGINT, on_sigint);
+  std::signal(SIGTERM, on_sigint);
+
+  std::string chip = args.chip_dir.empty() ? find_chip_dir() : args.chip_dir;
+  if (chip.empty()) { std::cerr << "[!] gpio-sim chip not found (is setup_sim.sh loaded?)\n"; return 1; }
+
+  if (!args.edges.empty()){
+    set_realtime(args);
+    return play_edges(args, chip);
+  }
+
+  auto lines = parse_map(args.map);
+  if (lines.empty()) { std::cerr << "[!] no valid line:dist pairs in '" << args.map << "'\n"; return 1; }
+
+  for (auto& l : lines){
+    l.fd = open_pull(chip, l.id);
+    if (::pwrite(l.fd, "pull-down", 9, 0) < 0) l.errors++;
+  }
+
+  FILE* log = nullptr;
+  if (!args.log.empty() && !(log = std::fopen(args.log.c_str(), "w"))) {
+    std::cerr << "[!] open " << args.log << ": " << std::strerror(errno) << "\n"; return 1;
+  }
+
+  set_realtime(args);
+
+  const int64_t period = (int64_t)std::llround(kNs / args.rate_hz);
+  const int64_t max_width = period - std::min<int64_t>(period / 10, 100000);  // keep a low gap
+  const int64_t start = now_ns() + 10000000;  // first edges 10 ms from now
+  const int64_t stop_at = args.duration_s > 0 ? start + (int64_t)(args.duration_s * kNs) : INT64_MAX;
+  for (size_t i = 0; i < lines.size(); i++){
+    lines[i].rise = start + (args.sim ? 0 : period * (int64_t)i / (int64_t)lines.size());
+    lines[i].next = lines[i].rise;
+  }
+
+  std::cerr << "[i] " << lines.size() << " lines on " << chip << ", " << args.rate_hz
+            << " Hz, " << (args.sim ? "simultaneous" : "staggered") << "\n";
+
+  int64_t late_max = 0, late_sum = 0;
+  uint64_t edges = 0, late_100us = 0;
+  while (!g_stop){
+    Line* l = &lines[0];
+    for (auto& c : lines) if (c.next < l->next) l = &c;
+    if (l->next >= stop_at && !l->high) break;
+
+    sleep_until(l->next, args.spin_us);
+    if (g_stop) break;
+    int64_t t = now_ns();
+    int64_t late = t - l->next;
+    late_max = std::max(late_max, late);
+    late_sum += late;
+    late_100us += late > 100000;
+    edges++;
+
+    if (!l->high){
+      double d = dist_at(l->script, (l->rise - start) / 1e9, args.loop);
+      int64_t width = (int64_t)std::llround(2.0 * d / kSound * 1e9);
+      if (width > max_width) { width = max_width; l->clamped++; }
+      if (::pwrite(l->fd, "pull-up", 7, 0) < 0) l->errors++;
+      l->high = true;
+      l->next = l->rise + std::max<int64_t>(width, 1000);
+    } else {
+      if (::pwrite(l->fd, "pull-down", 9, 0) < 0) l->errors++;
+      l->high = false;
+      l->pulses++;
+      l->rise += period;
+      l->next = l->rise;
+    }
+    if (log) std::fprintf(log, "%lld %d %c\n", (long long)t, l->id, l->high ? 'R' : 'F');
+  }
+
+  for (auto& l : lines){
+    if (l.high) ::pwrite(l.fd, "pull-down", 9, 0);
+    ::close(l.fd);
+    std::cerr << "[i] line " << l.id << ": pulses=" << l.pulses << " clamped=" << l.clamped
+              << " write_errors=" << l.errors << "\n";
+  }
+  if (log) std::fclose(log);
+  std::cerr << "[i] edges=" << edges << " late_avg_us=" << (edges ? late_sum / (double)edges / 1e3 : 0.0)
+            << " late_max_us=" << late_max / 1e3 << " late_gt_100us=" << late_100us << "\n";
+  return 0;
+}